@@ -1,14 +1,27 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <ctype.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
 
 // 定义常量
 #define MAP_ROWS 8
 #define MAP_COLS 30
+#define TOTAL_CELLS (2 * (MAP_ROWS + MAP_COLS - 2)) // 边界上的总格子数
 #define MAX_PLAYERS 4
-#define MAX_PROPERTIES 10
+#define MAX_PROPERTIES TOTAL_CELLS // 每块地产最多被一人持有
 #define MAX_ITEMS 10
 
 // 玩家结构体
@@ -22,9 +35,13 @@ typedef struct {
     int property_count;
     int items[MAX_ITEMS]; // 0:无 1:路障 2:机器娃娃 3:炸弹
     int item_count;
-    int hospitalized;
-    int imprisoned;
-    int god_mode; // 财神附身
+    // 住院、监禁和财神附身记为到期的回合序号（0 表示没有），剩余回合数由
+    // hospital_left / prison_left / god_left 根据当前回合序号算出，不需要每回合递减
+    int hospital_until;
+    int prison_until;
+    int god_until; // 财神附身
+    int is_bot; // 电脑玩家
+    int bankrupt; // 已破产
 } Player;
 
 // 地图格子类型
@@ -38,12 +55,538 @@ typedef struct {
     int item_type; // 道具类型
 } Cell;
 
-// 游戏状态
-Cell map[MAP_ROWS][MAP_COLS];
-Player players[MAX_PLAYERS];
-int player_count;
-int current_player;
-int game_over;
+// 地产价格与过路费，按 顶部、底部、左侧、右侧 排列
+typedef struct {
+    int price[4];
+    int toll[4];
+} Economy;
+
+enum { SIDE_TOP, SIDE_BOTTOM, SIDE_LEFT, SIDE_RIGHT };
+
+// 每个线程可以使用不同的参数（参数扫描时各线程评估不同的参数点）
+__thread Economy economy = {{200, 300, 200, 500}, {100, 150, 100, 250}};
+
+// 游戏状态（每个线程一份，机器人搜索线程在自己的副本上模拟）
+__thread Cell map[MAP_ROWS][MAP_COLS];
+__thread Player players[MAX_PLAYERS];
+__thread int player_count;
+__thread int current_player;
+__thread int game_over;
+__thread int turn_number; // 回合序号：每个座位轮到一次加一（包括被跳过的），当前玩家为 turn_number % player_count
+
+__thread uint64_t state_hash; // 当前局面的 Zobrist 哈希，由下方的修改函数增量维护
+
+// 游戏状态快照，用于在线程之间传递局面
+typedef struct {
+    Cell map[MAP_ROWS][MAP_COLS];
+    Player players[MAX_PLAYERS];
+    int player_count;
+    int current_player;
+    int game_over;
+    int turn_number;
+    uint64_t hash;
+} GameState;
+
+void schedule_rebuild();
+
+void save_state(GameState *s) {
+    memcpy(s->map, map, sizeof(map));
+    memcpy(s->players, players, sizeof(players));
+    s->player_count = player_count;
+    s->current_player = current_player;
+    s->game_over = game_over;
+    s->turn_number = turn_number;
+    s->hash = state_hash;
+}
+
+void load_state(const GameState *s) {
+    memcpy(map, s->map, sizeof(map));
+    memcpy(players, s->players, sizeof(players));
+    player_count = s->player_count;
+    current_player = s->current_player;
+    game_over = s->game_over;
+    turn_number = s->turn_number;
+    state_hash = s->hash;
+    schedule_rebuild();
+}
+
+// 静默模式：搜索和模拟时不输出游戏信息
+__thread int quiet;
+
+// 输出缓冲区，服务器模式下游戏信息写入会话的缓冲区
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} OutBuf;
+
+__thread OutBuf *game_out; // NULL 表示输出到标准输出
+
+void outbuf_append(OutBuf *b, const char *s, size_t len) {
+    if (b->len + len > b->cap) {
+        size_t cap = b->cap ? b->cap : 256;
+        while (cap < b->len + len) cap *= 2;
+        char *data = realloc(b->data, cap);
+        if (data == NULL) return;
+        b->data = data;
+        b->cap = cap;
+    }
+    memcpy(b->data + b->len, s, len);
+    b->len += len;
+}
+
+// 游戏信息输出，静默模式下丢弃
+void game_printf(const char *fmt, ...) {
+    if (quiet) return;
+    va_list ap;
+    va_start(ap, fmt);
+    if (game_out) {
+        char buf[1024];
+        int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+        if (n > 0) outbuf_append(game_out, buf, n < (int)sizeof(buf) ? (size_t)n : sizeof(buf) - 1);
+    } else {
+        vprintf(fmt, ap);
+    }
+    va_end(ap);
+}
+
+// 随机数：每个线程独立的 xorshift32 状态，可用种子复现
+__thread uint32_t rng_state = 2463534242u;
+
+void rng_seed(uint32_t seed) {
+    rng_state = seed ? seed : 2463534242u;
+}
+
+uint32_t rng_next() {
+    uint32_t x = rng_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return rng_state = x;
+}
+
+// 返回 [0, n) 的随机整数，n 不超过 65536
+int rng_range(int n) {
+    return (int)(((rng_next() >> 16) * (uint32_t)n) >> 16);
+}
+
+// ===================== 性能计数 =====================
+// --profile 时统计回合各阶段的用时。阶段可以嵌套（例如 handle_position 中等待输入），
+// 每个阶段只计自己的时间，嵌套阶段的时间从外层扣除。用时以时间戳计数器的周期为单位
+// 记入对数分桶的直方图（每个 2 的幂分 16 档，相对误差约 6%），输入 prof 命令或收到 SIGUSR1 时输出。
+// 只统计运行 game_loop 的线程，未开启时每个计时点只多一次线程局部变量的判断。
+
+#include <signal.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+typedef enum {
+    PROF_INPUT,     // 读取并解析输入
+    PROF_DECIDE,    // 电脑玩家决策
+    PROF_ROLL,      // 掷骰子
+    PROF_MOVE,      // move_player
+    PROF_HANDLE,    // handle_position
+    PROF_ITEM,      // 使用道具
+    PROF_RENDER,    // 显示地图和玩家状态
+    PROF_TURN,      // 整个回合，包含以上各阶段
+    PROF_PHASES
+} ProfPhase;
+
+#define PROF_SUB_BITS 4                                         // 每个 2 的幂分 16 档
+#define PROF_BUCKETS ((64 - PROF_SUB_BITS + 1) << PROF_SUB_BITS)
+#define PROF_DEPTH 8                                            // 阶段最多嵌套的层数
+
+typedef struct {
+    uint64_t counts[PROF_BUCKETS];
+    uint64_t count;
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+} ProfHistogram;
+
+const char *prof_names[PROF_PHASES] = {
+    "输入", "决策", "掷骰子", "移动", "落点处理", "道具", "显示", "整回合"
+};
+
+__thread int profiling;                 // 当前线程是否统计
+ProfHistogram prof_hist[PROF_PHASES];
+__thread int prof_depth;
+__thread int prof_stack[PROF_DEPTH];
+__thread uint64_t prof_mark[PROF_DEPTH];   // 该层最近一次开始（或恢复）计时的时刻
+__thread uint64_t prof_spent[PROF_DEPTH];  // 该层已累计的时间，不含嵌套阶段
+uint64_t prof_ticks0;                   // 开始统计时的计数器和时钟，用于换算周期
+struct timespec prof_time0;
+volatile sig_atomic_t prof_requested;   // 收到 SIGUSR1，在下一个回合开始时输出
+
+static inline uint64_t prof_ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+// 小于 16 的值各占一档，之后每个 2 的幂按最高 4 位之后的 4 位分档
+int prof_bucket(uint64_t v) {
+    if (v < (1u << PROF_SUB_BITS)) return (int)v;
+    int e = 63 - __builtin_clzll(v);
+    return ((e - PROF_SUB_BITS + 1) << PROF_SUB_BITS)
+         | (int)((v >> (e - PROF_SUB_BITS)) & ((1u << PROF_SUB_BITS) - 1));
+}
+
+// 分档的中间值
+uint64_t prof_bucket_value(int b) {
+    if (b < (1 << PROF_SUB_BITS)) return b;
+    int shift = (b >> PROF_SUB_BITS) - 1;
+    uint64_t low = (uint64_t)((1 << PROF_SUB_BITS) | (b & ((1 << PROF_SUB_BITS) - 1))) << shift;
+    return low + ((1ull << shift) >> 1);
+}
+
+void prof_record(int phase, uint64_t ticks) {
+    ProfHistogram *h = &prof_hist[phase];
+    h->counts[prof_bucket(ticks)]++;
+    if (h->count == 0 || ticks < h->min) h->min = ticks;
+    if (ticks > h->max) h->max = ticks;
+    h->count++;
+    h->total += ticks;
+}
+
+// 进入一个阶段，暂停外层阶段的计时
+static inline void prof_push(int phase) {
+    if (__builtin_expect(!profiling, 1)) return;
+    uint64_t now = prof_ticks();
+    if (prof_depth > 0) prof_spent[prof_depth - 1] += now - prof_mark[prof_depth - 1];
+    prof_stack[prof_depth] = phase;
+    prof_mark[prof_depth] = now;
+    prof_spent[prof_depth] = 0;
+    prof_depth++;
+}
+
+// 离开当前阶段，恢复外层阶段的计时
+static inline void prof_pop() {
+    if (__builtin_expect(!profiling, 1)) return;
+    uint64_t now = prof_ticks();
+    int d = --prof_depth;
+    prof_record(prof_stack[d], prof_spent[d] + now - prof_mark[d]);
+    if (d > 0) prof_mark[d - 1] = now;
+}
+
+void prof_signal(int sig) {
+    (void)sig;
+    prof_requested = 1;
+}
+
+// 在当前线程上开始统计
+void prof_start() {
+    profiling = 1;
+    prof_ticks0 = prof_ticks();
+    clock_gettime(CLOCK_MONOTONIC, &prof_time0);
+    signal(SIGUSR1, prof_signal);
+}
+
+// 不小于 q 比例样本的分档值
+uint64_t prof_percentile(const ProfHistogram *h, double q) {
+    uint64_t target = (uint64_t)ceil(q * h->count);
+    if (target == 0) target = 1;
+    uint64_t seen = 0;
+    for (int b = 0; b < PROF_BUCKETS; b++) {
+        seen += h->counts[b];
+        if (seen >= target) {
+            uint64_t v = prof_bucket_value(b);
+            return v > h->max ? h->max : v;
+        }
+    }
+    return h->max;
+}
+
+// 输出各阶段的统计（微秒），以及整回合用时的百分位分布
+void prof_dump() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double ns = (now.tv_sec - prof_time0.tv_sec) * 1e9 + (now.tv_nsec - prof_time0.tv_nsec);
+    uint64_t ticks = prof_ticks() - prof_ticks0;
+    double us = ticks ? ns / ticks / 1000 : 0;   // 每个周期的微秒数
+    
+    uint64_t phases_total = 0;
+    for (int i = 0; i < PROF_TURN; i++) {
+        phases_total += prof_hist[i].total;
+    }
+    
+    game_printf("\n      次数    平均(us)     p50(us)     p90(us)     p99(us)   p99.9(us)     最大(us)   占比  阶段\n");
+    for (int i = 0; i < PROF_PHASES; i++) {
+        const ProfHistogram *h = &prof_hist[i];
+        if (h->count == 0) continue;
+        game_printf("%10llu %11.2f %11.2f %11.2f %11.2f %11.2f %12.2f %5.1f%%  %s\n",
+                    (unsigned long long)h->count, (double)h->total / h->count * us,
+                    prof_percentile(h, 0.5) * us, prof_percentile(h, 0.9) * us,
+                    prof_percentile(h, 0.99) * us, prof_percentile(h, 0.999) * us, h->max * us,
+                    i < PROF_TURN && phases_total ? 100.0 * h->total / phases_total : 100.0,
+                    prof_names[i]);
+    }
+    
+    const ProfHistogram *turn = &prof_hist[PROF_TURN];
+    if (turn->count == 0) return;
+    static const double ladder[] = { 0.5, 0.75, 0.9, 0.95, 0.99, 0.999, 0.9999, 1.0 };
+    game_printf("\n整回合用时分布:\n");
+    for (size_t i = 0; i < sizeof(ladder) / sizeof(ladder[0]); i++) {
+        game_printf("  %8.4f%%  %12.2f us\n", 100 * ladder[i], prof_percentile(turn, ladder[i]) * us);
+    }
+}
+
+// ===================== Zobrist 哈希 =====================
+// 所有改变局面的操作都通过下面的函数进行，以便同步更新 state_hash。
+// 资金和点数按档位计入哈希，相近的局面共享搜索结果。
+
+#define CELL_COUNT (MAP_ROWS * MAP_COLS)
+#define MONEY_BUCKETS 64  // 每 500 元一档
+#define POINT_BUCKETS 32  // 每 50 点一档
+
+uint64_t z_position[MAX_PLAYERS][TOTAL_CELLS];
+uint64_t z_owner[CELL_COUNT][MAX_PLAYERS + 1];
+uint64_t z_level[CELL_COUNT][4];
+uint64_t z_cell_item[CELL_COUNT][4];
+uint64_t z_items[MAX_PLAYERS][4][MAX_ITEMS + 1];
+uint64_t z_money[MAX_PLAYERS][MONEY_BUCKETS];
+uint64_t z_points[MAX_PLAYERS][POINT_BUCKETS];
+uint64_t z_bankrupt[MAX_PLAYERS];
+uint64_t z_turn[MAX_PLAYERS];
+
+uint64_t splitmix64(uint64_t *x) {
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// 用固定种子生成哈希键，保证各线程和各次运行一致
+void init_zobrist() {
+    uint64_t seed = 20240601;
+    uint64_t *tables[] = {
+        &z_position[0][0], &z_owner[0][0], &z_level[0][0], &z_cell_item[0][0],
+        &z_items[0][0][0], &z_money[0][0], &z_points[0][0], z_bankrupt, z_turn
+    };
+    size_t sizes[] = {
+        sizeof(z_position), sizeof(z_owner), sizeof(z_level), sizeof(z_cell_item),
+        sizeof(z_items), sizeof(z_money), sizeof(z_points), sizeof(z_bankrupt), sizeof(z_turn)
+    };
+    for (size_t t = 0; t < sizeof(tables) / sizeof(tables[0]); t++) {
+        for (size_t i = 0; i < sizes[t] / sizeof(uint64_t); i++) {
+            tables[t][i] = splitmix64(&seed);
+        }
+    }
+}
+
+// 状态到期回合的哈希键：到期回合没有上限，用 splitmix64 混合代替查表
+enum { STATUS_HOSPITAL, STATUS_PRISON, STATUS_GOD };
+
+uint64_t z_deadline(int p, int kind, int until) {
+    if (until == 0) return 0;
+    uint64_t x = ((uint64_t)until << 16) ^ ((uint64_t)kind << 8) ^ (uint64_t)p;
+    return splitmix64(&x);
+}
+
+int clamp_bucket(int v, int n) {
+    return v < 0 ? 0 : (v >= n ? n - 1 : v);
+}
+
+int money_bucket(int money) {
+    return clamp_bucket(money / 500, MONEY_BUCKETS);
+}
+
+int point_bucket(int points) {
+    return clamp_bucket(points / 50, POINT_BUCKETS);
+}
+
+int count_items(const Player *p, int item) {
+    int n = 0;
+    for (int i = 0; i < p->item_count; i++) {
+        if (p->items[i] == item) n++;
+    }
+    return n;
+}
+
+// 单个玩家对哈希的贡献
+uint64_t player_hash(int i) {
+    const Player *p = &players[i];
+    uint64_t h = z_position[i][p->position]
+               ^ z_money[i][money_bucket(p->money)]
+               ^ z_points[i][point_bucket(p->points)]
+               ^ z_deadline(i, STATUS_HOSPITAL, p->hospital_until)
+               ^ z_deadline(i, STATUS_PRISON, p->prison_until)
+               ^ z_deadline(i, STATUS_GOD, p->god_until);
+    for (int item = 1; item <= 3; item++) {
+        h ^= z_items[i][item][count_items(p, item)];
+    }
+    if (p->bankrupt) h ^= z_bankrupt[i];
+    return h;
+}
+
+// 单个格子对哈希的贡献
+uint64_t cell_hash(int row, int col) {
+    const Cell *c = &map[row][col];
+    int k = row * MAP_COLS + col;
+    return z_owner[k][c->owner + 1]
+         ^ z_level[k][c->level]
+         ^ z_cell_item[k][c->has_item ? c->item_type : 0];
+}
+
+// 从头计算哈希，只在初始化和校验时使用
+uint64_t compute_hash() {
+    uint64_t h = z_turn[current_player];
+    for (int i = 0; i < MAP_ROWS; i++) {
+        for (int j = 0; j < MAP_COLS; j++) {
+            h ^= cell_hash(i, j);
+        }
+    }
+    for (int i = 0; i < player_count; i++) {
+        h ^= player_hash(i);
+    }
+    return h;
+}
+
+void change_money(int p, int delta) {
+    state_hash ^= z_money[p][money_bucket(players[p].money)];
+    players[p].money += delta;
+    state_hash ^= z_money[p][money_bucket(players[p].money)];
+}
+
+void change_points(int p, int delta) {
+    state_hash ^= z_points[p][point_bucket(players[p].points)];
+    players[p].points += delta;
+    state_hash ^= z_points[p][point_bucket(players[p].points)];
+}
+
+void set_position(int p, int position) {
+    position = ((position % TOTAL_CELLS) + TOTAL_CELLS) % TOTAL_CELLS;
+    state_hash ^= z_position[p][players[p].position] ^ z_position[p][position];
+    players[p].position = position;
+}
+
+// 玩家 p 在当前回合之后的第一个回合序号（当前玩家的本回合视为已经开始）
+int next_visit(int p) {
+    int n = player_count;
+    return turn_number + (p - current_player + n - 1) % n + 1;
+}
+
+// 玩家 p 在 until 之前还要被跳过的回合数
+int visits_before(int p, int until) {
+    if (until <= turn_number) return 0;
+    int nv = next_visit(p);
+    return until > nv ? (until - nv) / player_count : 0;
+}
+
+int hospital_left(int p) {
+    return visits_before(p, players[p].hospital_until);
+}
+
+int prison_left(int p) {
+    return visits_before(p, players[p].prison_until);
+}
+
+// 财神附身剩余回合：到期前的回合中去掉住院和监禁跳过的回合
+int god_left(int p) {
+    int until = players[p].god_until;
+    if (until <= turn_number) return 0;
+    int nv = next_visit(p);
+    if (until < nv) return 0;
+    int left = (until - nv) / player_count + 1 - hospital_left(p) - prison_left(p);
+    return left > 0 ? left : 0;
+}
+
+void set_deadline(int p, int kind, int *field, int until) {
+    state_hash ^= z_deadline(p, kind, *field) ^ z_deadline(p, kind, until);
+    *field = until;
+}
+
+// 财神附身按行动的回合计数，住院和监禁跳过的回合顺延
+void set_god_mode(int p, int turns) {
+    int skips = hospital_left(p) + prison_left(p);
+    int until = turns > 0 ? next_visit(p) + (turns + skips - 1) * player_count : 0;
+    set_deadline(p, STATUS_GOD, &players[p].god_until, until);
+}
+
+void schedule_block(int p);
+
+void set_hospitalized(int p, int turns) {
+    int god = god_left(p);
+    int until = turns > 0 ? next_visit(p) + turns * player_count : 0;
+    set_deadline(p, STATUS_HOSPITAL, &players[p].hospital_until, until);
+    set_god_mode(p, god);
+    schedule_block(p);
+}
+
+void set_imprisoned(int p, int turns) {
+    int god = god_left(p);
+    int until = turns > 0 ? next_visit(p) + turns * player_count : 0;
+    set_deadline(p, STATUS_PRISON, &players[p].prison_until, until);
+    set_god_mode(p, god);
+    schedule_block(p);
+}
+
+void set_bankrupt(int p) {
+    if (!players[p].bankrupt) state_hash ^= z_bankrupt[p];
+    players[p].bankrupt = 1;
+}
+
+void set_current_player(int p) {
+    state_hash ^= z_turn[current_player] ^ z_turn[p];
+    current_player = p;
+}
+
+// 道具栏中加入一个道具（调用方保证未满）
+void add_item(int p, int item) {
+    Player *pl = &players[p];
+    int n = count_items(pl, item);
+    state_hash ^= z_items[p][item][n] ^ z_items[p][item][n + 1];
+    pl->items[pl->item_count++] = item;
+}
+
+// 移除道具栏中第 index 个道具
+void remove_item(int p, int index) {
+    Player *pl = &players[p];
+    int item = pl->items[index];
+    int n = count_items(pl, item);
+    state_hash ^= z_items[p][item][n] ^ z_items[p][item][n - 1];
+    for (int j = index; j < pl->item_count - 1; j++) {
+        pl->items[j] = pl->items[j+1];
+    }
+    pl->item_count--;
+}
+
+void set_owner(int row, int col, int owner) {
+    int k = row * MAP_COLS + col;
+    state_hash ^= z_owner[k][map[row][col].owner + 1] ^ z_owner[k][owner + 1];
+    map[row][col].owner = owner;
+}
+
+void set_level(int row, int col, int level) {
+    int k = row * MAP_COLS + col;
+    state_hash ^= z_level[k][map[row][col].level] ^ z_level[k][level];
+    map[row][col].level = level;
+}
+
+// 设置格子上的道具，0 表示清除
+void set_cell_item(int row, int col, int item_type) {
+    Cell *c = &map[row][col];
+    int k = row * MAP_COLS + col;
+    state_hash ^= z_cell_item[k][c->has_item ? c->item_type : 0] ^ z_cell_item[k][item_type];
+    c->has_item = item_type != 0;
+    if (item_type) c->item_type = item_type;
+}
+
+// 决策点类型：电脑玩家和人类玩家在这些位置做选择
+enum { DECIDE_BUY, DECIDE_UPGRADE, DECIDE_SHOP, DECIDE_ITEM };
+
+int ask_yes_no(int kind, int player_index);
+int ask_shop_item(int player_index);
+
+// 服务器模式：人类玩家的决策无法立即读取，记下决策类型后让回合暂停
+__thread int serving;
+__thread int pending_decision = -1;
+int decide(int kind, int player_index);
 
 // 初始化地图为方形边界
 void init_map() {
@@ -63,29 +606,29 @@ void init_map() {
     // 顶部行
     for (int j = 0; j < MAP_COLS; j++) {
         map[0][j].type = 'O';
-        map[0][j].price = 200;
-        map[0][j].toll = 100;
+        map[0][j].price = economy.price[SIDE_TOP];
+        map[0][j].toll = economy.toll[SIDE_TOP];
     }
     
     // 底部行
     for (int j = 0; j < MAP_COLS; j++) {
         map[MAP_ROWS-1][j].type = 'O';
-        map[MAP_ROWS-1][j].price = 300;
-        map[MAP_ROWS-1][j].toll = 150;
+        map[MAP_ROWS-1][j].price = economy.price[SIDE_BOTTOM];
+        map[MAP_ROWS-1][j].toll = economy.toll[SIDE_BOTTOM];
     }
     
     // 左侧列
     for (int i = 1; i < MAP_ROWS-1; i++) {
         map[i][0].type = 'O';
-        map[i][0].price = 200;
-        map[i][0].toll = 100;
+        map[i][0].price = economy.price[SIDE_LEFT];
+        map[i][0].toll = economy.toll[SIDE_LEFT];
     }
     
     // 右侧列
     for (int i = 1; i < MAP_ROWS-1; i++) {
         map[i][MAP_COLS-1].type = 'O';
-        map[i][MAP_COLS-1].price = 500;
-        map[i][MAP_COLS-1].toll = 250;
+        map[i][MAP_COLS-1].price = economy.price[SIDE_RIGHT];
+        map[i][MAP_COLS-1].toll = economy.toll[SIDE_RIGHT];
     }
     
     // 设置特殊地点
@@ -117,9 +660,11 @@ void init_players(int count, int initial_money) {
         players[i].position = 0;
         players[i].property_count = 0;
         players[i].item_count = 0;
-        players[i].hospitalized = 0;
-        players[i].imprisoned = 0;
-        players[i].god_mode = 0;
+        players[i].hospital_until = 0;
+        players[i].prison_until = 0;
+        players[i].god_until = 0;
+        players[i].is_bot = 0;
+        players[i].bankrupt = 0;
         
         for (int j = 0; j < MAX_PROPERTIES; j++) {
             players[i].properties[j] = -1;
@@ -144,14 +689,15 @@ void init_players(int count, int initial_money) {
     players[3].symbol = 'J';
     
     current_player = 0;
+    turn_number = 0;
     game_over = 0;
+    state_hash = compute_hash();
+    schedule_rebuild();
 }
 
 // 将一维位置转换为二维坐标,确保了玩家沿着矩形边界顺时针移动，符合大富翁游戏的传统玩法
 void position_to_coord(int position, int *row, int *col) {
-    int total_cells = 2 * (MAP_ROWS + MAP_COLS - 2); // 边界上的总格子数
-    
-    position = position % total_cells;
+    position = position % TOTAL_CELLS;
     
     if (position < MAP_COLS) {
         // 顶部行
@@ -174,8 +720,9 @@ void position_to_coord(int position, int *row, int *col) {
 
 // 显示地图
 void display_map() {
-    printf("\n当前地图状态:\n");
-    printf("------------------------------------------------------------\n");
+    prof_push(PROF_RENDER);
+    game_printf("\n当前地图状态:\n");
+    game_printf("------------------------------------------------------------\n");
     
     for (int i = 0; i < MAP_ROWS; i++) {
         for (int j = 0; j < MAP_COLS; j++) {
@@ -191,79 +738,87 @@ void display_map() {
             }
             
             if (player_here != -1) {
-                printf("%c", players[player_here].symbol);
+                game_printf("%c", players[player_here].symbol);
             } else if (map[i][j].has_item) {
                 switch (map[i][j].item_type) {
-                    case 1: printf("#"); break; // 路障
-                    case 2: printf("@"); break; // 机器娃娃
-                    case 3: printf("@"); break; // 炸弹
-                    default: printf("?");
+                    case 1: game_printf("#"); break; // 路障
+                    case 2: game_printf("@"); break; // 机器娃娃
+                    case 3: game_printf("@"); break; // 炸弹
+                    default: game_printf("?");
                 }
             } else {
                 switch (map[i][j].type) {
-                    case 'S': printf("S"); break;
+                    case 'S': game_printf("S"); break;
                     case 'O': 
                         if (map[i][j].owner == -1) {
-                            printf("O");
+                            game_printf("O");
                         } else {
-                            printf("%d", map[i][j].level);
+                            game_printf("%d", map[i][j].level);
                         }
                         break;
-                    case 'T': printf("T"); break;
-                    case 'G': printf("G"); break;
-                    case 'M': printf("M"); break;
-                    case 'H': printf("H"); break;
-                    case 'P': printf("P"); break;
-                    default: printf("%c", map[i][j].type);
+                    case 'T': game_printf("T"); break;
+                    case 'G': game_printf("G"); break;
+                    case 'M': game_printf("M"); break;
+                    case 'H': game_printf("H"); break;
+                    case 'P': game_printf("P"); break;
+                    default: game_printf("%c", map[i][j].type);
                 }
             }
         }
-        printf("\n");
+        game_printf("\n");
     }
     
-    printf("------------------------------------------------------------\n");
-    printf("图例: S-起点 O-空地 T-道具屋 G-礼品屋 M-魔法屋 $-矿地 H-医院 P-监狱\n");
-    printf("      数字-地产等级(0-3) Q-钱夫人 A-阿土伯 S-孙小美 J-金贝贝\n");
-    printf("      #-路障 @-炸弹/机器娃娃\n");
+    game_printf("------------------------------------------------------------\n");
+    game_printf("图例: S-起点 O-空地 T-道具屋 G-礼品屋 M-魔法屋 $-矿地 H-医院 P-监狱\n");
+    game_printf("      数字-地产等级(0-3) Q-钱夫人 A-阿土伯 S-孙小美 J-金贝贝\n");
+    game_printf("      #-路障 @-炸弹/机器娃娃\n");
+    prof_pop();
 }
 
 // 显示玩家状态
 void display_player_status(int player_index) {
-    printf("\n%s 的状态:\n", players[player_index].name);
-    printf("资金: %d元\n", players[player_index].money);
-    printf("点数: %d点\n", players[player_index].points);
+    prof_push(PROF_RENDER);
+    game_printf("\n%s 的状态:\n", players[player_index].name);
+    game_printf("资金: %d元\n", players[player_index].money);
+    game_printf("点数: %d点\n", players[player_index].points);
     
     int row, col;
     position_to_coord(players[player_index].position, &row, &col);
-    printf("位置: (%d, %d)\n", row, col);
+    game_printf("位置: (%d, %d)\n", row, col);
     
-    printf("地产: %d处\n", players[player_index].property_count);
-    printf("道具: %d个\n", players[player_index].item_count);
+    game_printf("地产: %d处\n", players[player_index].property_count);
+    game_printf("道具: %d个\n", players[player_index].item_count);
     
-    if (players[player_index].hospitalized > 0) {
-        printf("状态: 住院中 (%d回合后出院)\n", players[player_index].hospitalized);
-    } else if (players[player_index].imprisoned > 0) {
-        printf("状态: 监禁中 (%d回合后释放)\n", players[player_index].imprisoned);
-    } else if (players[player_index].god_mode > 0) {
-        printf("状态: 财神附身 (%d回合有效)\n", players[player_index].god_mode);
+    if (hospital_left(player_index) > 0) {
+        game_printf("状态: 住院中 (%d回合后出院)\n", hospital_left(player_index));
+    } else if (prison_left(player_index) > 0) {
+        game_printf("状态: 监禁中 (%d回合后释放)\n", prison_left(player_index));
+    } else if (god_left(player_index) > 0) {
+        game_printf("状态: 财神附身 (%d回合有效)\n", god_left(player_index));
     } else {
-        printf("状态: 正常\n");
+        game_printf("状态: 正常\n");
     }
+    prof_pop();
 }
 
 // 掷骰子
 int roll_dice() {
-    return rand() % 6 + 1;
+    prof_push(PROF_ROLL);
+    int steps = rng_range(6) + 1;
+    prof_pop();
+    return steps;
 }
 
 // 移动玩家
 void move_player(int player_index, int steps) {
-    players[player_index].position = (players[player_index].position + steps) % (2 * (MAP_ROWS + MAP_COLS - 2));
+    prof_push(PROF_MOVE);
+    set_position(player_index, players[player_index].position + steps);
     
     int row, col;
     position_to_coord(players[player_index].position, &row, &col);
-    printf("%s 移动了 %d 步，到达位置 (%d, %d)\n", 
+    game_printf("%s 移动了 %d 步，到达位置 (%d, %d)\n", 
            players[player_index].name, steps, row, col);
+    prof_pop();
 }
 
 // 购买地产
@@ -272,23 +827,23 @@ void buy_property(int player_index) {
     position_to_coord(players[player_index].position, &row, &col);
     
     if (map[row][col].type != 'O') {
-        printf("此处不能购买地产\n");
+        game_printf("此处不能购买地产\n");
         return;
     }
     
     if (map[row][col].owner != -1) {
-        printf("此地已有主人\n");
+        game_printf("此地已有主人\n");
         return;
     }
     
     if (players[player_index].money >= map[row][col].price) {
-        players[player_index].money -= map[row][col].price;
-        map[row][col].owner = player_index;
+        change_money(player_index, -map[row][col].price);
+        set_owner(row, col, player_index);
         players[player_index].properties[players[player_index].property_count++] = players[player_index].position;
-        printf("%s 购买了位置 (%d, %d) 的地产，花费 %d元\n", 
+        game_printf("%s 购买了位置 (%d, %d) 的地产，花费 %d元\n", 
                players[player_index].name, row, col, map[row][col].price);
     } else {
-        printf("资金不足，无法购买此地产\n");
+        game_printf("资金不足，无法购买此地产\n");
     }
 }
 
@@ -298,17 +853,17 @@ void upgrade_property(int player_index) {
     position_to_coord(players[player_index].position, &row, &col);
     
     if (map[row][col].owner != player_index) {
-        printf("这不是你的地产\n");
+        game_printf("这不是你的地产\n");
         return;
     }
     
     if (map[row][col].level < 3 && players[player_index].money >= map[row][col].price) {
-        players[player_index].money -= map[row][col].price;
-        map[row][col].level++;
-        printf("%s 升级了位置 (%d, %d) 的地产，现在是 %d 级，花费 %d元\n", 
+        change_money(player_index, -map[row][col].price);
+        set_level(row, col, map[row][col].level + 1);
+        game_printf("%s 升级了位置 (%d, %d) 的地产，现在是 %d 级，花费 %d元\n", 
                players[player_index].name, row, col, map[row][col].level, map[row][col].price);
     } else {
-        printf("无法升级此地产\n");
+        game_printf("无法升级此地产\n");
     }
 }
 
@@ -320,185 +875,198 @@ void pay_toll(int player_index) {
     int owner = map[row][col].owner;
     int toll = map[row][col].toll * (map[row][col].level + 1);
     
-    if (players[player_index].god_mode > 0) {
-        printf("财神附身，免付过路费\n");
+    if (god_left(player_index) > 0) {
+        game_printf("财神附身，免付过路费\n");
         return;
     }
     
-    if (players[owner].hospitalized > 0 || players[owner].imprisoned > 0) {
-        printf("地主正在医院或监狱中，免付过路费\n");
+    if (hospital_left(owner) > 0 || prison_left(owner) > 0) {
+        game_printf("地主正在医院或监狱中，免付过路费\n");
         return;
     }
     
     if (players[player_index].money >= toll) {
-        players[player_index].money -= toll;
-        players[owner].money += toll;
-        printf("%s 向 %s 支付了过路费 %d元\n", 
+        change_money(player_index, -toll);
+        change_money(owner, toll);
+        game_printf("%s 向 %s 支付了过路费 %d元\n", 
                players[player_index].name, players[owner].name, toll);
     } else {
-        printf("%s 资金不足，无法支付过路费，破产了！\n", players[player_index].name);
+        game_printf("%s 资金不足，无法支付过路费，破产了！\n", players[player_index].name);
+        set_bankrupt(player_index);
         game_over = 1;
     }
 }
 
+// 触发玩家所在格子上的道具
+void trigger_cell_item(int player_index) {
+    int row, col;
+    position_to_coord(players[player_index].position, &row, &col);
+    Cell *cell = &map[row][col];
+    
+    // 检查是否有道具效果
+    if (cell->has_item) {
+        game_printf("触发了道具效果: ");
+        switch (cell->item_type) {
+            case 1: // 路障
+                game_printf("被路障拦截，停止一回合\n");
+                // 简化版：跳过下一回合
+                break;
+            case 3: // 炸弹
+                game_printf("被炸弹炸伤，住院3天\n");
+                set_hospitalized(player_index, 3);
+                break;
+        }
+        set_cell_item(row, col, 0); // 移除道具
+    }
+}
+
+// 道具屋购买道具，无效编号返回0
+int buy_shop_item(int player_index, int item) {
+    int cost = 0;
+    switch (item) {
+        case 1: cost = 50; break;
+        case 2: cost = 30; break;
+        case 3: cost = 50; break;
+        default: game_printf("无效的道具编号\n"); return 0;
+    }
+    if (players[player_index].item_count >= MAX_ITEMS) {
+        game_printf("道具栏已满，无法获得新道具\n");
+    } else if (players[player_index].points >= cost) {
+        change_points(player_index, -cost);
+        add_item(player_index, item);
+        const char *item_name = "";
+        switch (item) {
+            case 1: item_name = "路障"; break;
+            case 2: item_name = "机器娃娃"; break;
+            case 3: item_name = "炸弹"; break;
+        }
+        game_printf("获得了 %s\n", item_name);
+    } else {
+        game_printf("点数不足，无法购买道具\n");
+    }
+    return 1;
+}
+
 // 处理玩家到达的位置
 void handle_position(int player_index) {
     int row, col;
     position_to_coord(players[player_index].position, &row, &col);
     Cell *cell = &map[row][col];
     
-    printf("%s 到达了位置 (%d, %d): ", players[player_index].name, row, col);
+    game_printf("%s 到达了位置 (%d, %d): ", players[player_index].name, row, col);
     
     switch (cell->type) {
         case 'S':
-            printf("起点\n");
+            game_printf("起点\n");
             break;
             
         case 'O':
             if (cell->owner == -1) {
-                printf("空地，可以购买\n");
-                printf("购买价格: %d元\n", cell->price);
-                printf("是否购买? (y/n): ");
-                char choice;
-                scanf(" %c", &choice);
-                if (tolower(choice) == 'y') {
+                game_printf("空地，可以购买\n");
+                game_printf("购买价格: %d元\n", cell->price);
+                game_printf("是否购买? (y/n): ");
+                if (ask_yes_no(DECIDE_BUY, player_index)) {
                     buy_property(player_index);
                 }
             } else if (cell->owner == player_index) {
-                printf("自己的地产，可以升级\n");
-                printf("升级价格: %d元\n", cell->price);
-                printf("是否升级? (y/n): ");
-                char choice;
-                scanf(" %c", &choice);
-                if (tolower(choice) == 'y') {
+                game_printf("自己的地产，可以升级\n");
+                game_printf("升级价格: %d元\n", cell->price);
+                game_printf("是否升级? (y/n): ");
+                if (ask_yes_no(DECIDE_UPGRADE, player_index)) {
                     upgrade_property(player_index);
                 }
             } else {
-                printf("%s 的地产，需要支付过路费\n", players[cell->owner].name);
-                printf("过路费: %d元\n", cell->toll * (cell->level + 1));
+                game_printf("%s 的地产，需要支付过路费\n", players[cell->owner].name);
+                game_printf("过路费: %d元\n", cell->toll * (cell->level + 1));
                 pay_toll(player_index);
             }
             break;
             
         case 'T':
-            printf("道具屋\n价格如下所示：\n");
-            printf("1. 路障 50点数\n");
-            printf("2. 机器娃娃 30点数\n");
-            printf("3. 炸弹 50点数\n");
+            game_printf("道具屋\n价格如下所示：\n");
+            game_printf("1. 路障 50点数\n");
+            game_printf("2. 机器娃娃 30点数\n");
+            game_printf("3. 炸弹 50点数\n");
             // 根据输入的序号获得对应的道具并扣除相应的点数
-            int item = 0;
-            int cost = 0;
-            printf("请输入道具编号: ");
-            scanf("%d", &item);
-            switch (item) {
-                case 1: cost = 50; break;
-                case 2: cost = 30; break;
-                case 3: cost = 50; break;
-                default: printf("无效的道具编号\n"); return;
-            }
-            if (players[player_index].points >= cost) {
-                players[player_index].points -= cost;
-                players[player_index].items[players[player_index].item_count++] = item;
-                const char *item_name = "";
-                switch (item) {
-                    case 1: item_name = "路障"; break;
-                    case 2: item_name = "机器娃娃"; break;
-                    case 3: item_name = "炸弹"; break;
-                }
-                printf("获得了 %s\n", item_name);
-            } else if (players[player_index].points < cost) {
-                printf("点数不足，无法购买道具\n");
-            } else if (players[player_index].item_count >= MAX_ITEMS) {
-                printf("道具栏已满，无法获得新道具\n");
-            }
+            game_printf("请输入道具编号: ");
+            int item = ask_shop_item(player_index);
+            if (pending_decision >= 0 || !buy_shop_item(player_index, item)) return;
             break;
             
         case 'G':
-            printf("礼品屋\n");
+            game_printf("礼品屋\n");
             // 简化版：随机获得一个礼品
-            int gift = rand() % 3 + 1;
+            int gift = rng_range(3) + 1;
             switch (gift) {
                 case 1:
-                    players[player_index].money += 2000;
-                    printf("获得了 2000元奖金\n");
+                    change_money(player_index, 2000);
+                    game_printf("获得了 2000元奖金\n");
                     break;
                 case 2:
-                    players[player_index].points += 200;
-                    printf("获得了 200点\n");
+                    change_points(player_index, 200);
+                    game_printf("获得了 200点\n");
                     break;
                 case 3:
-                    players[player_index].god_mode = 5;
-                    printf("获得了财神附身，5回合有效\n");
+                    set_god_mode(player_index, 5);
+                    game_printf("获得了财神附身，5回合有效\n");
                     break;
             }
             break;
             
         case 'M':
-            printf("魔法屋\n");
+            game_printf("魔法屋\n");
             // 简化版：随机获得或失去一些资源
-            int effect = rand() % 3;
+            int effect = rng_range(3);
             switch (effect) {
                 case 0:
-                    players[player_index].money += 1000;
-                     printf("获得了 1000元\n");
+                    change_money(player_index, 1000);
+                     game_printf("获得了 1000元\n");
                     break;
                 case 1:
-                    players[player_index].points += 100;
-                    printf("获得了 100点\n");
+                    change_points(player_index, 100);
+                    game_printf("获得了 100点\n");
                     break;
                 case 2:
-                    players[player_index].money -= 500;
-                    printf("失去了 500元\n");
+                    change_money(player_index, -500);
+                    game_printf("失去了 500元\n");
                     break;
                 }
                 break;
 
         case '$':
-            printf("矿地\n");
+            game_printf("矿地\n");
             // 获得点数
-            int points = 20 + rand() % 80;
-            players[player_index].points += points;
-            printf("获得了 %d 点\n", points);
+            int points = 20 + rng_range(80);
+            change_points(player_index, points);
+            game_printf("获得了 %d 点\n", points);
             break;
             
         case 'H':
-            printf("医院\n");
-            if (players[player_index].hospitalized == 0) {
-                printf("只是路过医院\n");
+            game_printf("医院\n");
+            if (hospital_left(player_index) == 0) {
+                game_printf("只是路过医院\n");
             } else {
-                printf("正在医院接受治疗\n");
+                game_printf("正在医院接受治疗\n");
             }
             break;
             
         case 'P':
-            printf("监狱\n");
-            if (players[player_index].imprisoned == 0) {
-                printf("只是路过监狱\n");
+            game_printf("监狱\n");
+            if (prison_left(player_index) == 0) {
+                game_printf("只是路过监狱\n");
             } else {
-                printf("正在监狱服刑\n");
+                game_printf("正在监狱服刑\n");
             }
             break;
             
         default:
-            printf("未知地点\n");
+            game_printf("未知地点\n");
             break;
     }
     
-    // 检查是否有道具效果
-    if (cell->has_item) {
-        printf("触发了道具效果: ");
-        switch (cell->item_type) {
-            case 1: // 路障
-                printf("被路障拦截，停止一回合\n");
-                // 简化版：跳过下一回合
-                break;
-            case 3: // 炸弹
-                printf("被炸弹炸伤，住院3天\n");
-                players[player_index].hospitalized = 3;
-                break;
-        }
-        cell->has_item = 0; // 移除道具
-    }
+    // 服务器模式下等待玩家回答，回答后由 resume_turn 继续
+    if (pending_decision >= 0) return;
+    trigger_cell_item(player_index);
 }
 
 // 使用路障
@@ -508,11 +1076,7 @@ void use_block(int player_index, int distance) {
         for (int i = 0; i < players[player_index].item_count; i++) {
             if (players[player_index].items[i] == 1) {
                 has_block = 1;
-                // 移除道具
-                for (int j = i; j < players[player_index].item_count - 1; j++) {
-                    players[player_index].items[j] = players[player_index].items[j+1];
-                }
-                players[player_index].item_count--;
+                remove_item(player_index, i); // 移除道具
                 break;
             }
         }
@@ -521,14 +1085,13 @@ void use_block(int player_index, int distance) {
             int target_pos = (players[player_index].position + distance + (2 * (MAP_ROWS + MAP_COLS - 2))) % (2 * (MAP_ROWS + MAP_COLS - 2));
             int row, col;
             position_to_coord(target_pos, &row, &col);
-            map[row][col].has_item = 1;
-            map[row][col].item_type = 1;
-            printf("在位置 (%d, %d) 放置了路障\n", row, col);
+            set_cell_item(row, col, 1);
+            game_printf("在位置 (%d, %d) 放置了路障\n", row, col);
         } else {
-            printf("没有路障道具\n");
+            game_printf("没有路障道具\n");
         }
     } else {
-        printf("没有可用道具\n");
+        game_printf("没有可用道具\n");
     }
 }
 
@@ -539,11 +1102,7 @@ void use_bomb(int player_index, int distance) {
         for (int i = 0; i < players[player_index].item_count; i++) {
             if (players[player_index].items[i] == 3) {
                 has_bomb = 1;
-                // 移除道具
-                for (int j = i; j < players[player_index].item_count - 1; j++) {
-                    players[player_index].items[j] = players[player_index].items[j+1];
-                }
-                players[player_index].item_count--;
+                remove_item(player_index, i); // 移除道具
                 break;
             }
         }
@@ -552,14 +1111,13 @@ void use_bomb(int player_index, int distance) {
             int target_pos = (players[player_index].position + distance + (2 * (MAP_ROWS + MAP_COLS - 2))) % (2 * (MAP_ROWS + MAP_COLS - 2));
             int row, col;
             position_to_coord(target_pos, &row, &col);
-            map[row][col].has_item = 1;
-            map[row][col].item_type = 3;
-            printf("在位置 (%d, %d) 放置了炸弹\n", row, col);
+            set_cell_item(row, col, 3);
+            game_printf("在位置 (%d, %d) 放置了炸弹\n", row, col);
         } else {
-            printf("没有炸弹道具\n");
+            game_printf("没有炸弹道具\n");
         }
     } else {
-        printf("没有可用道具\n");
+        game_printf("没有可用道具\n");
     }
 }
 
@@ -570,173 +1128,4408 @@ void use_robot(int player_index) {
         for (int i = 0; i < players[player_index].item_count; i++) {
             if (players[player_index].items[i] == 2) {
                 has_robot = 1;
-                // 移除道具
-                for (int j = i; j < players[player_index].item_count - 1; j++) {
-                    players[player_index].items[j] = players[player_index].items[j+1];
-                }
-                players[player_index].item_count--;
+                remove_item(player_index, i); // 移除道具
                 break;
             }
         }
         
         if (has_robot) {
-            printf("清除了前方10格内的道具\n");
+            game_printf("清除了前方10格内的道具\n");
             for (int i = 1; i <= 10; i++) {
                 int target_pos = (players[player_index].position + i) % (2 * (MAP_ROWS + MAP_COLS - 2));
                 int row, col;
                 position_to_coord(target_pos, &row, &col);
-                map[row][col].has_item = 0;
+                set_cell_item(row, col, 0);
             }
         } else {
-            printf("没有机器娃娃道具\n");
+            game_printf("没有机器娃娃道具\n");
         }
     } else {
-        printf("没有可用道具\n");
+        game_printf("没有可用道具\n");
     }
 }
 
-// 显示帮助信息
-void show_help() {
-    printf("\n可用命令:\n");
-    printf("roll        - 掷骰子移动\n");
-    printf("block n     - 在前后n格放置路障\n");
-    printf("bomb n      - 在前后n格放置炸弹\n");
-    printf("robot       - 使用机器娃娃清除前方道路\n");
-    printf("query       - 查看自己的资产\n");
-    printf("map         - 显示地图\n");
-    printf("help        - 显示帮助信息\n");
-    printf("quit        - 退出游戏\n");
+// ===================== 回合调度 =====================
+// 住院和监禁的玩家按恢复行动的回合序号挂在时间轮上，能行动的玩家记在位图中。
+// 每回合结束时只取出本轮内到期的槽位，再在位图中找下一个能行动的座位，
+// 被跳过的座位不需要逐个处理：剩余回合数都由到期回合序号算出。
+
+#define WHEEL_SLOTS 64   // 槽数，与 occupied 位图的位数一致
+
+// 时间轮：每个槽覆盖 width 个回合序号，按到期回合散列到槽中，超过一圈的条目留在槽里等下一圈。
+// 槽内是按到期回合排序的双向链表，到期时从表头取出，每次只处理真正到期的条目。
+typedef struct {
+    int head[WHEEL_SLOTS];
+    int tail[WHEEL_SLOTS];
+    uint64_t occupied;    // 非空槽位图
+    int width;            // 每个槽覆盖的回合数
+    int expired;          // 已经处理到的回合序号
+    int *next;            // 以下数组按条目编号索引
+    int *prev;
+    int *due;             // 到期回合序号，0 表示不在轮上
+} TimerWheel;
+
+void wheel_init(TimerWheel *w, int *next, int *prev, int *due, int count, int width, int now) {
+    for (int i = 0; i < WHEEL_SLOTS; i++) {
+        w->head[i] = w->tail[i] = -1;
+    }
+    w->occupied = 0;
+    w->width = width;
+    w->expired = now;
+    w->next = next;
+    w->prev = prev;
+    w->due = due;
+    memset(due, 0, sizeof(int) * count);
 }
 
-// 主游戏循环
-void game_loop() {
-    srand(time(NULL));
-    
-    printf("欢迎来到大富翁简化版游戏!\n");
-    
-    // 设置玩家数量和初始资金
-    int initial_money = 10000;
-    printf("请输入玩家数量 (2-4): ");
-    scanf("%d", &player_count);
+// 加入一个条目（调用方保证 due 大于 expired 且条目不在轮上）。
+// 从表尾向前找插入位置，到期回合按加入顺序递增时为 O(1)
+void wheel_add(TimerWheel *w, int id, int due) {
+    int slot = (due / w->width) & (WHEEL_SLOTS - 1);
+    int after = w->tail[slot];
+    while (after >= 0 && w->due[after] > due) after = w->prev[after];
     
-    if (player_count < 2 || player_count > 4) {
-        printf("玩家数量必须在2-4之间，已设置为2\n");
-        player_count = 2;
+    w->due[id] = due;
+    w->prev[id] = after;
+    w->next[id] = after >= 0 ? w->next[after] : w->head[slot];
+    if (after >= 0) {
+        w->next[after] = id;
+    } else {
+        w->head[slot] = id;
     }
-    
-    printf("请输入初始资金 (默认10000): ");
-    scanf("%d", &initial_money);
-    
-    if (initial_money < 1000 || initial_money > 50000) {
-        printf("初始资金必须在1000-50000之间，已设置为10000\n");
-        initial_money = 10000;
+    if (w->next[id] >= 0) {
+        w->prev[w->next[id]] = id;
+    } else {
+        w->tail[slot] = id;
+    }
+    w->occupied |= 1ull << slot;
+}
+
+void wheel_remove(TimerWheel *w, int id) {
+    if (w->due[id] == 0) return;
+    int slot = (w->due[id] / w->width) & (WHEEL_SLOTS - 1);
+    if (w->prev[id] >= 0) {
+        w->next[w->prev[id]] = w->next[id];
+    } else {
+        w->head[slot] = w->next[id];
+    }
+    if (w->next[id] >= 0) {
+        w->prev[w->next[id]] = w->prev[id];
+    } else {
+        w->tail[slot] = w->prev[id];
+    }
+    if (w->head[slot] < 0) w->occupied &= ~(1ull << slot);
+    w->due[id] = 0;
+}
+
+// 取出到期回合不超过 upto 的条目，对每个条目调用 fire
+void wheel_expire(TimerWheel *w, int upto, void (*fire)(int id)) {
+    if (upto <= w->expired) return;
+    if (w->occupied == 0) {
+        w->expired = upto;
+        return;
     }
     
-    // 初始化游戏
-    init_map();
-    init_players(player_count, initial_money);
-    
-    printf("游戏开始! 初始资金: %d元\n", initial_money);
+    // 只看覆盖 [expired, upto] 的非空槽
+    int first = w->expired / w->width;
+    int span = upto / w->width - first + 1;
+    uint64_t range = ~0ull;
+    if (span < WHEEL_SLOTS) {
+        int shift = first & (WHEEL_SLOTS - 1);
+        range = (1ull << span) - 1;
+        range = (range << shift) | (shift ? range >> (WHEEL_SLOTS - shift) : 0);
+    }
+    w->expired = upto;
     
-    // 游戏主循环
-    while (!game_over) {
-        Player *current = &players[current_player];
-        
-        // 跳过住院或监禁的玩家
-        if (current->hospitalized > 0) {
-            printf("\n%s 正在住院，跳过本回合 (%d回合后出院)\n", 
-                   current->name, current->hospitalized);
-            current->hospitalized--;
-            current_player = (current_player + 1) % player_count;
-            continue;
-        }
-        
-        if (current->imprisoned > 0) {
-            printf("\n%s 正在监禁中，跳过本回合 (%d回合后释放)\n", 
-                   current->name, current->imprisoned);
-            current->imprisoned--;
-            current_player = (current_player + 1) % player_count;
-            continue;
-        }
-        
-        // 财神模式递减
-        if (current->god_mode > 0) {
-            current->god_mode--;
-        }
-        
-        printf("\n轮到 %s 的回合\n", current->name);
-        display_player_status(current_player);
-        
-        char command[20];
-        int steps;
-        
-        while (1) {
-            display_map();
-            printf("\n请输入命令 (输入help查看帮助): ");
-            scanf("%s", command);
-            
-            if (strcasecmp(command, "step") == 0){
-                scanf("%d", &steps);
-                printf("移动 %d 步", steps);
-                move_player(current_player, steps);
-                handle_position(current_player);
-                break;
-            }
-            if (strcasecmp(command, "roll") == 0) {
-                steps = roll_dice();
-                printf("掷出了 %d 点\n", steps);
-                move_player(current_player, steps);
-                handle_position(current_player);
-                display_map();
-                break;
-            } else if (strcasecmp(command, "block") == 0) {
-                int distance;
-                scanf("%d", &distance);
-                if (distance >= -10 && distance <= 10 && distance != 0) {
-                    use_block(current_player, distance);
-                    display_map();
-                } else {
-                    printf("距离必须在-10到10之间且不能为0\n");
-                }
-            } else if (strcasecmp(command, "bomb") == 0) {
-                int distance;
-                scanf("%d", &distance);
-                if (distance >= -10 && distance <= 10 && distance != 0) {
-                    use_bomb(current_player, distance);
-                    display_map();
-                } else {
-                    printf("距离必须在-10到10之间且不能为0\n");
-                }
-            } else if (strcasecmp(command, "robot") == 0) {
-                use_robot(current_player);
-                display_map();
-            } else if (strcasecmp(command, "query") == 0) {
-                display_player_status(current_player);
-            } else if (strcasecmp(command, "help") == 0) {
-                show_help();
-            } else if (strcasecmp(command, "quit") == 0) {
-                game_over = 1;
-                break;
-            } else {
-                printf("未知命令，请输入help查看帮助\n");
-            }
-            display_map();
-        }
-        
-        // 检查游戏是否结束
-        if (current->money < 0) {
-            printf("%s 破产了！游戏结束\n", current->name);
-            game_over = 1;
+    uint64_t slots = w->occupied & range;
+    while (slots) {
+        int slot = __builtin_ctzll(slots);
+        slots &= slots - 1;
+        while (w->head[slot] >= 0 && w->due[w->head[slot]] <= upto) {
+            int id = w->head[slot];
+            wheel_remove(w, id);
+            fire(id);
         }
-        
-        // 切换到下一个玩家
-        current_player = (current_player + 1) % player_count;
     }
-    
-    printf("游戏结束!\n");
 }
 
-int main() {
-    game_loop();
-    return 0;
-}
\ No newline at end of file
+// 位图中从 from 开始的第一个置位，没有时返回 -1
+int bitset_next(const uint64_t *bits, int n, int from) {
+    for (int word = from >> 6; word < (n + 63) >> 6; word++) {
+        uint64_t w = bits[word];
+        if (word == from >> 6) w &= ~0ull << (from & 63);
+        if (w) {
+            int i = (word << 6) + __builtin_ctzll(w);
+            return i < n ? i : -1;
+        }
+    }
+    return -1;
+}
+
+__thread TimerWheel status_wheel;
+__thread int wheel_next_link[MAX_PLAYERS];
+__thread int wheel_prev_link[MAX_PLAYERS];
+__thread int wheel_due[MAX_PLAYERS];
+__thread uint64_t ready_players[(MAX_PLAYERS + 63) / 64]; // 下一个回合能行动的玩家
+
+void mark_ready(int p) {
+    ready_players[p >> 6] |= 1ull << (p & 63);
+}
+
+// 玩家恢复行动的回合序号
+int blocked_until(int p) {
+    int until = players[p].hospital_until;
+    return players[p].prison_until > until ? players[p].prison_until : until;
+}
+
+// 住院或监禁状态改变后重新登记玩家
+void schedule_block(int p) {
+    wheel_remove(&status_wheel, p);
+    int until = blocked_until(p);
+    if (until > next_visit(p)) {
+        ready_players[p >> 6] &= ~(1ull << (p & 63));
+        wheel_add(&status_wheel, p, until);
+    } else {
+        mark_ready(p);
+    }
+}
+
+// 根据玩家的到期回合重建时间轮和位图（载入局面后调用）
+void schedule_rebuild() {
+    wheel_init(&status_wheel, wheel_next_link, wheel_prev_link, wheel_due, MAX_PLAYERS, 1, turn_number);
+    memset(ready_players, 0, sizeof(ready_players));
+    for (int p = 0; p < player_count; p++) {
+        schedule_block(p);
+    }
+}
+
+// 被跳过的回合只在需要输出时逐个提示
+void skip_message(int visit) {
+    int p = visit % player_count;
+    if (players[p].hospital_until > visit) {
+        game_printf("\n%s 正在住院，跳过本回合 (%d回合后出院)\n",
+               players[p].name, (players[p].hospital_until - visit) / player_count);
+    } else {
+        game_printf("\n%s 正在监禁中，跳过本回合 (%d回合后释放)\n",
+               players[p].name, (players[p].prison_until - visit) / player_count);
+    }
+}
+
+// 切换到下一个能行动的玩家
+void next_turn() {
+    int n = player_count;
+    int t = turn_number;
+    if (game_over) {
+        turn_number = t + 1;
+        set_current_player((current_player + 1) % n);
+        return;
+    }
+    
+    // 恢复时间落在 (base, base + n] 的玩家在这一轮里能行动
+    int base = t;
+    wheel_expire(&status_wheel, base + n, mark_ready);
+    int following = current_player + 1 < n ? current_player + 1 : 0;
+    if (ready_players[following >> 6] & (1ull << (following & 63))) {
+        turn_number = t + 1;
+        set_current_player(following);
+        return;
+    }
+    while (bitset_next(ready_players, n, 0) < 0) {
+        base += n;
+        wheel_expire(&status_wheel, base + n, mark_ready);
+    }
+    int seat = bitset_next(ready_players, n, current_player + 1);
+    if (seat < 0) seat = bitset_next(ready_players, n, 0);
+    int visit = base + (seat - current_player + n - 1) % n + 1;
+    
+    if (!quiet) {
+        for (int v = t + 1; v < visit; v++) {
+            skip_message(v);
+        }
+    }
+    turn_number = visit;
+    set_current_player(seat);
+}
+
+// 回合结束：检查破产并切换到下一个玩家
+void end_turn() {
+    Player *current = &players[current_player];
+    
+    if (current->money < 0) {
+        game_printf("%s 破产了！游戏结束\n", current->name);
+        set_bankrupt(current_player);
+        game_over = 1;
+    }
+    
+#ifdef HASH_CHECK
+    if (state_hash != compute_hash()) {
+        fprintf(stderr, "Zobrist 哈希不一致\n");
+        abort();
+    }
+#endif
+    next_turn();
+}
+
+// 掷骰子前进并处理落点
+void roll_and_move(int player_index) {
+    int steps = roll_dice();
+    game_printf("掷出了 %d 点\n", steps);
+    move_player(player_index, steps);
+    prof_push(PROF_HANDLE);
+    handle_position(player_index);
+    prof_pop();
+}
+
+// ===================== 电脑玩家 (MCTS) =====================
+
+// 回合开始时的道具动作: 0 不用道具, 1 机器娃娃, 2-21 路障, 22-41 炸弹 (距离 -10..-1, 1..10)
+#define ITEM_ACTIONS 42
+#define MAX_SEARCH_THREADS 64
+#define ROLLOUT_TURNS 200 // 每次模拟最多进行的回合数
+#define UCB_C 0.5
+
+int bot_count = 0;      // 电脑玩家数量（占据最后几个座位）
+int bot_think_ms = 500; // 每次决策的思考时间
+int bot_threads = 0;    // 搜索线程数，0 表示使用全部CPU
+
+__thread int searching; // 当前线程正在做随机模拟
+__thread int (*sim_policy)(int kind, int player_index, const int *actions, int n); // 批量模拟时的固定策略
+
+// 道具动作编号换算为放置距离
+int action_distance(int action) {
+    int k = (action - 2) % 20;
+    return k < 10 ? k - 10 : k - 9;
+}
+
+// 放置距离换算为道具动作编号，base 为 2（路障）或 22（炸弹）
+int distance_action(int base, int distance) {
+    return base + (distance < 0 ? distance + 10 : distance + 9);
+}
+
+// 执行回合开始时的道具动作
+void apply_item_action(int player_index, int action) {
+    if (action == 0) return;
+    prof_push(PROF_ITEM);
+    if (action == 1) {
+        use_robot(player_index);
+    } else if (action < 22) {
+        use_block(player_index, action_distance(action));
+    } else {
+        use_bomb(player_index, action_distance(action));
+    }
+    prof_pop();
+}
+
+int has_item(int player_index, int item) {
+    for (int i = 0; i < players[player_index].item_count; i++) {
+        if (players[player_index].items[i] == item) return 1;
+    }
+    return 0;
+}
+
+// 列出决策点的合法选项，返回选项个数
+int legal_actions(int kind, int player_index, int *actions) {
+    Player *p = &players[player_index];
+    int row, col, n = 0;
+    position_to_coord(p->position, &row, &col);
+    
+    actions[n++] = 0;
+    switch (kind) {
+        case DECIDE_BUY:
+            if (p->money >= map[row][col].price) actions[n++] = 1;
+            break;
+        case DECIDE_UPGRADE:
+            if (map[row][col].level < 3 && p->money >= map[row][col].price) actions[n++] = 1;
+            break;
+        case DECIDE_SHOP:
+            if (p->item_count < MAX_ITEMS) {
+                if (p->points >= 50) actions[n++] = 1;
+                if (p->points >= 30) actions[n++] = 2;
+                if (p->points >= 50) actions[n++] = 3;
+            }
+            break;
+        case DECIDE_ITEM:
+            if (has_item(player_index, 2)) actions[n++] = 1;
+            if (has_item(player_index, 1)) {
+                for (int a = 2; a < 22; a++) actions[n++] = a;
+            }
+            if (has_item(player_index, 3)) {
+                for (int a = 22; a < 42; a++) actions[n++] = a;
+            }
+            break;
+    }
+    return n;
+}
+
+// 模拟中的默认策略：留足现金时买地和升级，偶尔随机使用道具
+int rollout_policy(int kind, int player_index, const int *actions, int n) {
+    if (n == 1) return actions[0];
+    
+    switch (kind) {
+        case DECIDE_BUY:
+        case DECIDE_UPGRADE: {
+            int row, col;
+            position_to_coord(players[player_index].position, &row, &col);
+            int left = players[player_index].money - map[row][col].price;
+            return left >= 1000 || rng_range(4) == 0;
+        }
+        case DECIDE_ITEM:
+            if (rng_range(4) != 0) return 0;
+            return actions[1 + rng_range(n - 1)];
+        default:
+            return actions[rng_range(n)];
+    }
+}
+
+// 决策点之后继续完成当前回合（与 handle_position 和 game_loop 的流程一致）
+void resume_turn(int kind, int action) {
+    int p = current_player;
+    
+    switch (kind) {
+        case DECIDE_BUY:
+            if (action) buy_property(p);
+            trigger_cell_item(p);
+            break;
+        case DECIDE_UPGRADE:
+            if (action) upgrade_property(p);
+            trigger_cell_item(p);
+            break;
+        case DECIDE_SHOP:
+            if (buy_shop_item(p, action)) trigger_cell_item(p);
+            break;
+        case DECIDE_ITEM:
+            apply_item_action(p, action);
+            roll_and_move(p);
+            break;
+    }
+    end_turn();
+}
+
+// 所有玩家都由默认策略操作的完整回合
+void auto_turn() {
+    int p = current_player;
+    apply_item_action(p, decide(DECIDE_ITEM, p));
+    roll_and_move(p);
+    end_turn();
+}
+
+// 资产估值：现金加地产（按投入计算），破产为0
+int net_worth(int player_index) {
+    Player *p = &players[player_index];
+    if (p->bankrupt) return 0;
+    
+    int worth = p->money > 0 ? p->money : 0;
+    for (int i = 0; i < p->property_count; i++) {
+        int row, col;
+        position_to_coord(p->properties[i], &row, &col);
+        worth += map[row][col].price * (map[row][col].level + 1);
+    }
+    return worth;
+}
+
+// 局面对某玩家的价值：其资产占全体资产的比例
+double evaluate(int player_index) {
+    long total = 0;
+    for (int i = 0; i < player_count; i++) {
+        total += net_worth(i);
+    }
+    return total > 0 ? (double)net_worth(player_index) / total : 0.0;
+}
+
+double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// ===================== 置换表 =====================
+// 所有搜索线程共享，无锁。每项保存 (key ^ data, data)，读到被并发写撕裂的项时
+// 校验失败，当作未命中处理。一个桶4项恰好一条缓存行，按访问次数最少者替换。
+// 表项以 "局面哈希 ^ 动作键" 为键，记录在该局面选择该动作后的模拟次数与累计价值，
+// 价值按做决策的玩家计算，因此在不同决策之间也可以复用。
+
+#define TT_BUCKET 4
+#define TT_VISIT_SHIFT 40
+#define TT_VALUE_ONE 1024 // 价值定点数的 1.0
+#define TT_VISITS(d) ((long)((d) >> TT_VISIT_SHIFT))
+#define TT_VALUE(d) ((double)((d) & ((1ull << TT_VISIT_SHIFT) - 1)) / TT_VALUE_ONE)
+#define MAX_PATH 64
+
+typedef struct {
+    _Atomic uint64_t check; // key ^ data
+    _Atomic uint64_t data;  // 高24位模拟次数，低40位累计价值
+} TTEntry;
+
+TTEntry *tt_table;
+uint64_t tt_mask;  // 桶数 - 1
+int tt_mb = 64;    // 置换表大小 (MB)
+uint64_t z_action[4][ITEM_ACTIONS];
+
+// 分配置换表（只在主线程、搜索开始前调用）
+void tt_init() {
+    uint64_t seed = 20240602;
+    for (int k = 0; k < 4; k++) {
+        for (int a = 0; a < ITEM_ACTIONS; a++) {
+            z_action[k][a] = splitmix64(&seed);
+        }
+    }
+    
+    uint64_t buckets = 1;
+    while (buckets * 2 * TT_BUCKET * sizeof(TTEntry) <= (uint64_t)tt_mb << 20) buckets *= 2;
+    tt_table = aligned_alloc(64, buckets * TT_BUCKET * sizeof(TTEntry));
+    if (tt_table == NULL) {
+        perror("aligned_alloc");
+        exit(1);
+    }
+    memset(tt_table, 0, buckets * TT_BUCKET * sizeof(TTEntry));
+    tt_mask = buckets - 1;
+}
+
+// 查询置换表，未命中返回0
+uint64_t tt_probe(uint64_t key) {
+    TTEntry *b = &tt_table[(key & tt_mask) * TT_BUCKET];
+    for (int i = 0; i < TT_BUCKET; i++) {
+        uint64_t data = atomic_load_explicit(&b[i].data, memory_order_relaxed);
+        uint64_t check = atomic_load_explicit(&b[i].check, memory_order_relaxed);
+        if ((check ^ data) == key) return data;
+    }
+    return 0;
+}
+
+// 累加一次模拟结果，并发时可能丢失少量更新
+void tt_update(uint64_t key, double value) {
+    TTEntry *b = &tt_table[(key & tt_mask) * TT_BUCKET];
+    TTEntry *slot = NULL;
+    uint64_t data = 0;
+    long fewest = -1;
+    
+    for (int i = 0; i < TT_BUCKET; i++) {
+        uint64_t d = atomic_load_explicit(&b[i].data, memory_order_relaxed);
+        uint64_t c = atomic_load_explicit(&b[i].check, memory_order_relaxed);
+        if ((c ^ d) == key) {
+            slot = &b[i];
+            data = d;
+            break;
+        }
+        long v = TT_VISITS(d);
+        if (fewest < 0 || v < fewest) {
+            fewest = v;
+            slot = &b[i];
+        }
+    }
+    
+    if (TT_VISITS(data) >= (1l << (64 - TT_VISIT_SHIFT)) - 1) return;
+    data += (1ull << TT_VISIT_SHIFT) + (uint64_t)(value * TT_VALUE_ONE);
+    atomic_store_explicit(&slot->data, data, memory_order_relaxed);
+    atomic_store_explicit(&slot->check, key ^ data, memory_order_relaxed);
+}
+
+// UCB1 选择，未访问过的动作优先
+int ucb_pick(const long *visits, const double *value, int n, long total) {
+    int best = 0;
+    double best_score = -1.0;
+    for (int i = 0; i < n; i++) {
+        if (visits[i] == 0) return i;
+        double score = value[i] / visits[i] + UCB_C * sqrt(log((double)total) / visits[i]);
+        if (score > best_score) {
+            best_score = score;
+            best = i;
+        }
+    }
+    return best;
+}
+
+// 本次模拟在置换表中经过的节点，模拟结束后按各自决策玩家回传价值
+__thread struct {
+    uint64_t key;
+    int player;
+} tree_path[MAX_PATH];
+__thread int path_len;
+__thread int in_tree;   // 模拟仍在已展开的节点中
+__thread long tt_lookups, tt_found;
+
+void path_push(uint64_t key, int player_index) {
+    if (path_len < MAX_PATH) {
+        tree_path[path_len].key = key;
+        tree_path[path_len].player = player_index;
+        path_len++;
+    }
+}
+
+// 模拟中的树内决策：按置换表统计做UCB选择，遇到新局面则展开并转为默认策略
+int tree_select(int kind, int player_index, const int *actions, int n) {
+    long visits[ITEM_ACTIONS];
+    double value[ITEM_ACTIONS];
+    long total = 0;
+    
+    for (int i = 0; i < n; i++) {
+        uint64_t d = tt_probe(state_hash ^ z_action[kind][actions[i]]);
+        visits[i] = TT_VISITS(d);
+        value[i] = TT_VALUE(d);
+        total += visits[i];
+        tt_lookups++;
+        if (d) tt_found++;
+    }
+    
+    int action;
+    if (total == 0) {
+        in_tree = 0;
+        action = rollout_policy(kind, player_index, actions, n);
+    } else {
+        action = actions[ucb_pick(visits, value, n, total)];
+    }
+    path_push(state_hash ^ z_action[kind][action], player_index);
+    return action;
+}
+
+// 单个搜索线程的任务与统计
+typedef struct {
+    const GameState *root;
+    int kind;
+    int player;
+    int n;
+    const int *actions;
+    double deadline;
+    uint32_t seed;
+    long visits[ITEM_ACTIONS];
+    double value[ITEM_ACTIONS];
+    long tt_lookups;
+    long tt_found;
+} SearchJob;
+
+// 搜索线程：根节点和已展开节点按共享置换表的统计做UCB1选择，其余部分随机模拟
+void *search_worker(void *arg) {
+    SearchJob *job = arg;
+    quiet = 1;
+    searching = 1;
+    rng_seed(job->seed);
+    tt_lookups = tt_found = 0;
+    
+    for (long iter = 0; ; iter++) {
+        if ((iter & 15) == 0 && now_ms() >= job->deadline) break;
+        
+        load_state(job->root);
+        path_len = 0;
+        in_tree = 1;
+        int action = tree_select(job->kind, job->player, job->actions, job->n);
+        int best = 0;
+        while (job->actions[best] != action) best++;
+        
+        resume_turn(job->kind, action);
+        for (int t = 0; t < ROLLOUT_TURNS && !game_over; t++) {
+            auto_turn();
+        }
+        
+        double worth[MAX_PLAYERS];
+        double total = 0;
+        for (int i = 0; i < player_count; i++) {
+            worth[i] = net_worth(i);
+            total += worth[i];
+        }
+        for (int i = 0; i < path_len; i++) {
+            tt_update(tree_path[i].key, total > 0 ? worth[tree_path[i].player] / total : 0.0);
+        }
+        
+        job->visits[best]++;
+        job->value[best] += total > 0 ? worth[job->player] / total : 0.0;
+    }
+    job->tt_lookups = tt_lookups;
+    job->tt_found = tt_found;
+    return NULL;
+}
+
+// 多线程蒙特卡洛树搜索，在思考时间内选出模拟次数最多的动作
+int mcts_decide(int kind, int player_index, const int *actions, int n) {
+    if (n == 1) return actions[0];
+    
+    int threads = bot_threads > 0 ? bot_threads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) threads = 1;
+    if (threads > MAX_SEARCH_THREADS) threads = MAX_SEARCH_THREADS;
+    
+    if (tt_table == NULL) tt_init();
+    
+    GameState root;
+    save_state(&root);
+    
+    SearchJob jobs[MAX_SEARCH_THREADS];
+    pthread_t tids[MAX_SEARCH_THREADS];
+    double deadline = now_ms() + bot_think_ms;
+    
+    for (int t = 0; t < threads; t++) {
+        memset(&jobs[t], 0, sizeof(jobs[t]));
+        jobs[t].root = &root;
+        jobs[t].kind = kind;
+        jobs[t].player = player_index;
+        jobs[t].n = n;
+        jobs[t].actions = actions;
+        jobs[t].deadline = deadline;
+        jobs[t].seed = rng_state ^ (0x9E3779B9u * (uint32_t)(t + 1));
+        if (pthread_create(&tids[t], NULL, search_worker, &jobs[t]) != 0) {
+            threads = t;
+            break;
+        }
+    }
+    
+    long visits[ITEM_ACTIONS] = {0};
+    double value[ITEM_ACTIONS] = {0};
+    long total = 0, lookups = 0, found = 0;
+    for (int t = 0; t < threads; t++) {
+        pthread_join(tids[t], NULL);
+        for (int i = 0; i < n; i++) {
+            visits[i] += jobs[t].visits[i];
+            value[i] += jobs[t].value[i];
+            total += jobs[t].visits[i];
+        }
+        lookups += jobs[t].tt_lookups;
+        found += jobs[t].tt_found;
+    }
+    
+    int best = 0;
+    for (int i = 1; i < n; i++) {
+        if (visits[i] > visits[best]) best = i;
+    }
+    game_printf("[%s 模拟了 %ld 局, 预期资产占比 %.1f%%, 置换表命中 %.1f%%] ",
+                players[player_index].name, total,
+                visits[best] ? 100.0 * value[best] / visits[best] : 0.0,
+                lookups ? 100.0 * found / lookups : 0.0);
+    return actions[best];
+}
+
+// 决策入口：模拟中使用默认策略，电脑玩家使用MCTS
+int decide(int kind, int player_index) {
+    int actions[ITEM_ACTIONS];
+    int n = legal_actions(kind, player_index, actions);
+    
+    if (sim_policy) return sim_policy(kind, player_index, actions, n);
+    if (searching) {
+        if (in_tree && n > 1) return tree_select(kind, player_index, actions, n);
+        return rollout_policy(kind, player_index, actions, n);
+    }
+    prof_push(PROF_DECIDE);
+    int action = mcts_decide(kind, player_index, actions, n);
+    prof_pop();
+    return action;
+}
+
+// 是/否决策：人类玩家从输入读取
+int ask_yes_no(int kind, int player_index) {
+    char choice;
+    if (searching || players[player_index].is_bot) {
+        choice = decide(kind, player_index) ? 'y' : 'n';
+        game_printf("%c\n", choice);
+    } else if (serving) {
+        pending_decision = kind;
+        return 0;
+    } else {
+        prof_push(PROF_INPUT);
+        scanf(" %c", &choice);
+        prof_pop();
+    }
+    return tolower(choice) == 'y';
+}
+
+// 道具屋选择：人类玩家从输入读取
+int ask_shop_item(int player_index) {
+    int item = 0;
+    if (searching || players[player_index].is_bot) {
+        item = decide(DECIDE_SHOP, player_index);
+        game_printf("%d\n", item);
+    } else if (serving) {
+        pending_decision = DECIDE_SHOP;
+        return 0;
+    } else {
+        prof_push(PROF_INPUT);
+        scanf("%d", &item);
+        prof_pop();
+    }
+    return item;
+}
+
+// 显示帮助信息
+void show_help() {
+    game_printf("\n可用命令:\n");
+    game_printf("roll        - 掷骰子移动\n");
+    game_printf("block n     - 在前后n格放置路障\n");
+    game_printf("bomb n      - 在前后n格放置炸弹\n");
+    game_printf("robot       - 使用机器娃娃清除前方道路\n");
+    game_printf("query       - 查看自己的资产\n");
+    game_printf("map         - 显示地图\n");
+    game_printf("prof        - 显示各阶段用时统计 (需 --profile)\n");
+    game_printf("help        - 显示帮助信息\n");
+    game_printf("quit        - 退出游戏\n");
+}
+
+// ===================== 共享内存导出 =====================
+// 游戏进程把当前局面写入 POSIX 共享内存，外部的看板或机器人进程直接映射读取。
+// 写者用顺序锁：写之前把序号加一（变成奇数），写完再加一；读者拷贝前后序号相同
+// 且为偶数时快照一致，否则重试。读者不加锁也不进行系统调用，不会阻塞写者。
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#define SHM_MAGIC 0x52494348u   // "RICH"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t size;           // sizeof(GameState)，读者据此检查布局是否一致
+    _Atomic uint32_t seq;    // 奇数表示正在写
+    uint32_t pad;
+    uint64_t updates;        // 写入次数
+    GameState state;
+} SharedGame;
+
+SharedGame *shm_game;        // 写者的映射，NULL 表示未导出
+const char *shm_name;
+int shm_interval_ms = 200;   // 读者刷新间隔，0 表示连续读取并校验快照
+
+// 创建共享内存段，之后的 shm_publish 都写入其中
+int shm_export(const char *name) {
+    int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+    if (fd < 0 || ftruncate(fd, sizeof(SharedGame)) < 0) {
+        perror(name);
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    shm_game = mmap(NULL, sizeof(SharedGame), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shm_game == MAP_FAILED) {
+        perror("mmap");
+        shm_game = NULL;
+        return -1;
+    }
+    memset(shm_game, 0, sizeof(SharedGame));
+    shm_game->size = sizeof(GameState);
+    shm_name = name;
+    atomic_thread_fence(memory_order_release);
+    shm_game->magic = SHM_MAGIC;
+    return 0;
+}
+
+// 局面有变化时写入共享内存
+void shm_publish() {
+    SharedGame *g = shm_game;
+    if (g == NULL) return;
+    if (g->updates > 0 && g->state.hash == state_hash && g->state.game_over == game_over) return;
+    
+    uint32_t seq = atomic_load_explicit(&g->seq, memory_order_relaxed);
+    atomic_store_explicit(&g->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    save_state(&g->state);
+    g->updates++;
+    atomic_store_explicit(&g->seq, seq + 2, memory_order_release);
+}
+
+// 对局结束后删除共享内存段的名字，已映射的读者不受影响
+void shm_close() {
+    if (shm_game == NULL) return;
+    munmap(shm_game, sizeof(SharedGame));
+    shm_unlink(shm_name);
+    shm_game = NULL;
+}
+
+// 读取一致的快照，返回重试次数
+int shm_snapshot(SharedGame *g, GameState *out, uint64_t *updates) {
+    int retries = 0;
+    for (;;) {
+        uint32_t before = atomic_load_explicit(&g->seq, memory_order_acquire);
+        if (!(before & 1)) {
+            memcpy(out, &g->state, sizeof(GameState));
+            *updates = g->updates;
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(&g->seq, memory_order_relaxed) == before) return retries;
+        }
+        retries++;
+    }
+}
+
+// 读者入口：定时显示局面，间隔为 0 时连续读取并用 compute_hash 校验每个快照
+int shm_watch(const char *name) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        perror(name);
+        return 1;
+    }
+    SharedGame *g = mmap(NULL, sizeof(SharedGame), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (g == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    if (g->magic != SHM_MAGIC || g->size != sizeof(GameState)) {
+        fprintf(stderr, "%s 不是本程序导出的局面\n", name);
+        return 1;
+    }
+    
+    GameState snap;
+    uint64_t updates = 0, shown = UINT64_MAX;
+    long snapshots = 0, retries = 0, torn = 0;
+    double start = now_ms(), report = start;
+    
+    do {
+        retries += shm_snapshot(g, &snap, &updates);
+        snapshots++;
+        load_state(&snap);
+        
+        if (shm_interval_ms == 0) {
+            if (updates > 0 && compute_hash() != snap.hash) torn++;
+            double now = now_ms();
+            if (now - report >= 1000 || game_over) {
+                printf("快照 %ld (%.0f/秒), 重试 %ld, 不一致 %ld, 写入 %lu 次\n",
+                       snapshots, snapshots * 1000.0 / (now - start), retries, torn, (unsigned long)updates);
+                fflush(stdout);
+                report = now;
+            }
+            continue;
+        }
+        
+        if (updates != shown && updates > 0) {
+            game_printf("\033[H\033[2J");
+            display_map();
+            for (int i = 0; i < player_count; i++) {
+                display_player_status(i);
+            }
+            game_printf("\n写入 %lu 次, 快照 %ld 次, 重试 %ld 次\n", (unsigned long)updates, snapshots, retries);
+            fflush(stdout);
+            shown = updates;
+        }
+        usleep(shm_interval_ms * 1000);
+    } while (!game_over);
+    
+    munmap(g, sizeof(SharedGame));
+    return 0;
+}
+
+// 命令执行结果
+enum { CMD_AGAIN, CMD_MOVED, CMD_QUIT };
+
+int command_has_arg(const char *command) {
+    return strcasecmp(command, "step") == 0 || strcasecmp(command, "block") == 0
+        || strcasecmp(command, "bomb") == 0;
+}
+
+// 执行当前玩家的一条命令，arg 为 step/block/bomb 的参数
+int exec_command(const char *command, int arg) {
+    if (strcasecmp(command, "step") == 0) {
+        game_printf("移动 %d 步", arg);
+        move_player(current_player, arg);
+        prof_push(PROF_HANDLE);
+        handle_position(current_player);
+        prof_pop();
+        return CMD_MOVED;
+    }
+    if (strcasecmp(command, "roll") == 0) {
+        int steps = roll_dice();
+        game_printf("掷出了 %d 点\n", steps);
+        move_player(current_player, steps);
+        prof_push(PROF_HANDLE);
+        handle_position(current_player);
+        prof_pop();
+        if (pending_decision < 0) display_map();
+        return CMD_MOVED;
+    } else if (strcasecmp(command, "block") == 0) {
+        if (arg >= -10 && arg <= 10 && arg != 0) {
+            prof_push(PROF_ITEM);
+            use_block(current_player, arg);
+            prof_pop();
+            display_map();
+        } else {
+            game_printf("距离必须在-10到10之间且不能为0\n");
+        }
+    } else if (strcasecmp(command, "bomb") == 0) {
+        if (arg >= -10 && arg <= 10 && arg != 0) {
+            prof_push(PROF_ITEM);
+            use_bomb(current_player, arg);
+            prof_pop();
+            display_map();
+        } else {
+            game_printf("距离必须在-10到10之间且不能为0\n");
+        }
+    } else if (strcasecmp(command, "robot") == 0) {
+        prof_push(PROF_ITEM);
+        use_robot(current_player);
+        prof_pop();
+        display_map();
+    } else if (strcasecmp(command, "query") == 0) {
+        display_player_status(current_player);
+    } else if (strcasecmp(command, "map") == 0) {
+        // 每条命令之后都会显示地图
+    } else if (strcasecmp(command, "prof") == 0) {
+        if (profiling) {
+            prof_dump();
+        } else {
+            game_printf("未开启性能计数，请用 --profile 启动\n");
+        }
+    } else if (strcasecmp(command, "help") == 0) {
+        show_help();
+    } else if (strcasecmp(command, "quit") == 0) {
+        return CMD_QUIT;
+    } else {
+        game_printf("未知命令，请输入help查看帮助\n");
+    }
+    return CMD_AGAIN;
+}
+
+// 主游戏循环
+void game_loop() {
+    rng_seed((uint32_t)time(NULL));
+    
+    game_printf("欢迎来到大富翁简化版游戏!\n");
+    
+    // 设置玩家数量和初始资金
+    int initial_money = 10000;
+    game_printf("请输入玩家数量 (2-4): ");
+    scanf("%d", &player_count);
+    
+    if (player_count < 2 || player_count > 4) {
+        game_printf("玩家数量必须在2-4之间，已设置为2\n");
+        player_count = 2;
+    }
+    
+    game_printf("请输入初始资金 (默认10000): ");
+    scanf("%d", &initial_money);
+    
+    if (initial_money < 1000 || initial_money > 50000) {
+        game_printf("初始资金必须在1000-50000之间，已设置为10000\n");
+        initial_money = 10000;
+    }
+    
+    // 初始化游戏
+    init_map();
+    init_players(player_count, initial_money);
+    
+    game_printf("游戏开始! 初始资金: %d元\n", initial_money);
+    
+    // 后几个座位由电脑玩家接管
+    if (bot_count > player_count) bot_count = player_count;
+    for (int i = player_count - bot_count; i < player_count; i++) {
+        players[i].is_bot = 1;
+    }
+    shm_publish();
+    
+    // 游戏主循环
+    while (!game_over) {
+        if (prof_requested) {
+            prof_requested = 0;
+            prof_dump();
+        }
+        uint64_t turn_start = profiling ? prof_ticks() : 0;
+        
+        // 住院或监禁的玩家已由 next_turn 跳过
+        Player *current = &players[current_player];
+        
+        game_printf("\n轮到 %s 的回合\n", current->name);
+        display_player_status(current_player);
+        
+        char command[20];
+        
+        // 电脑玩家：先决定是否使用道具，再掷骰子
+        if (current->is_bot) {
+            apply_item_action(current_player, decide(DECIDE_ITEM, current_player));
+            roll_and_move(current_player);
+            display_map();
+            shm_publish();
+        }
+        
+        while (!current->is_bot) {
+            display_map();
+            game_printf("\n请输入命令 (输入help查看帮助): ");
+            prof_push(PROF_INPUT);
+            scanf("%s", command);
+            
+            int arg = 0;
+            if (command_has_arg(command)) scanf("%d", &arg);
+            prof_pop();
+            
+            int result = exec_command(command, arg);
+            shm_publish();
+            if (result == CMD_QUIT) {
+                game_over = 1;
+                break;
+            }
+            if (result == CMD_MOVED) break;
+            display_map();
+        }
+        
+        // 检查游戏是否结束并切换到下一个玩家
+        end_turn();
+        shm_publish();
+        if (profiling) prof_record(PROF_TURN, prof_ticks() - turn_start);
+    }
+    
+    game_printf("游戏结束!\n");
+    shm_publish();
+    if (profiling) prof_dump();
+}
+
+// ===================== 批量模拟 (SIMD) =====================
+// 每条 SIMD 通道独立进行一局游戏，所有玩家使用 greedy_policy。
+// 各格子的效果用掩码同时计算，每条通道只在需要时推进自己的随机数，
+// 因此同一种子下与标量引擎（auto_turn）的结果逐局一致。
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#if defined(__AVX512F__)
+#define SIM_LANES 16
+#elif defined(__AVX2__)
+#define SIM_LANES 8
+#else
+#define SIM_LANES 4
+#endif
+
+#define SIM_RESERVE 1000      // 买地/升级后至少保留的现金
+#define SIM_BOMB_DISTANCE 3   // 炸弹放在前方的格数
+#define SIM_MAX_TURNS 2000    // 每局最多回合数
+
+typedef int32_t lane_t __attribute__((vector_size(SIM_LANES * sizeof(int32_t))));
+typedef uint32_t ulane_t __attribute__((vector_size(SIM_LANES * sizeof(uint32_t))));
+
+// 按位置排列的地图常量
+typedef struct {
+    int32_t type[TOTAL_CELLS];
+    int32_t price[TOTAL_CELLS];
+    int32_t toll[TOTAL_CELLS];
+} SimBoard;
+
+// 一局的结果
+typedef struct {
+    int turns;
+    int winner;
+    int money[MAX_PLAYERS];
+} SimResult;
+
+// 所有通道的游戏状态，每个字段一个向量
+typedef struct {
+    lane_t money[MAX_PLAYERS];
+    lane_t points[MAX_PLAYERS];
+    lane_t position[MAX_PLAYERS];
+    lane_t hospitalized[MAX_PLAYERS];
+    lane_t imprisoned[MAX_PLAYERS];
+    lane_t god_mode[MAX_PLAYERS];
+    lane_t bombs[MAX_PLAYERS];
+    lane_t bankrupt[MAX_PLAYERS];
+    lane_t owner[TOTAL_CELLS];
+    lane_t level[TOTAL_CELLS];
+    lane_t item[TOTAL_CELLS];
+    lane_t current;
+    lane_t game_over;
+    lane_t turns;
+    ulane_t rng;
+} SimLanes;
+
+// 批量模拟的固定策略：留足现金后买地和升级，点数够就买炸弹并放在前方
+int greedy_policy(int kind, int player_index, const int *actions, int n) {
+    int row, col;
+    position_to_coord(players[player_index].position, &row, &col);
+    
+    switch (kind) {
+        case DECIDE_BUY:
+        case DECIDE_UPGRADE:
+            return n > 1 && players[player_index].money - map[row][col].price >= SIM_RESERVE;
+        case DECIDE_SHOP:
+            return actions[n - 1] == 3 ? 3 : 0;
+        case DECIDE_ITEM:
+            return has_item(player_index, 3) ? distance_action(22, SIM_BOMB_DISTANCE) : 0;
+    }
+    return 0;
+}
+
+void sim_board_from_map(SimBoard *b) {
+    for (int pos = 0; pos < TOTAL_CELLS; pos++) {
+        int row, col;
+        position_to_coord(pos, &row, &col);
+        b->type[pos] = map[row][col].type;
+        b->price[pos] = map[row][col].price;
+        b->toll[pos] = map[row][col].toll;
+    }
+}
+
+// 标量引擎跑一局（调用方需设置 quiet 和 sim_policy）
+void sim_scalar_game(uint32_t seed, SimResult *r) {
+    init_map();
+    init_players(MAX_PLAYERS, 10000);
+    for (int i = 0; i < player_count; i++) {
+        players[i].is_bot = 1;
+    }
+    rng_seed(seed);
+    
+    // 按回合序号计数，被跳过的回合也算在内，与 SIMD 引擎一致
+    while (!game_over && turn_number < SIM_MAX_TURNS) {
+        auto_turn();
+    }
+    
+    r->turns = game_over ? turn_number : SIM_MAX_TURNS;
+    r->winner = 0;
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        r->money[i] = players[i].money;
+        if (net_worth(i) > net_worth(r->winner)) r->winner = i;
+    }
+}
+
+static inline lane_t lane_blend(lane_t mask, lane_t a, lane_t b) {
+    return (mask & a) | (~mask & b);
+}
+
+// 按通道各自的下标读取 table[idx]
+static inline lane_t lane_gather(const int32_t *table, lane_t idx) {
+#if defined(__AVX512F__)
+    return (lane_t)_mm512_i32gather_epi32((__m512i)idx, table, 4);
+#elif defined(__AVX2__)
+    return (lane_t)_mm256_i32gather_epi32(table, (__m256i)idx, 4);
+#else
+    lane_t r;
+    for (int l = 0; l < SIM_LANES; l++) r[l] = table[idx[l]];
+    return r;
+#endif
+}
+
+// 读取每条通道在 pos 处的格子状态
+static inline lane_t lane_cell(const lane_t *cells, lane_t pos, lane_t lane_id) {
+    return lane_gather((const int32_t *)cells, pos * SIM_LANES + lane_id);
+}
+
+// 在 mask 选中的通道写入格子状态
+static inline void lane_set_cell(lane_t *cells, lane_t pos, lane_t v, lane_t mask) {
+    for (int l = 0; l < SIM_LANES; l++) {
+        if (mask[l]) cells[pos[l]][l] = v[l];
+    }
+}
+
+// 取出每条通道中玩家 who 的字段
+static inline lane_t lane_player(const lane_t *field, lane_t who) {
+    lane_t r = {0};
+    for (int p = 0; p < MAX_PLAYERS; p++) r |= field[p] & (who == p);
+    return r;
+}
+
+// 给每条通道中玩家 who 的字段加上 delta（未选中的通道 delta 为0）
+static inline void lane_player_add(lane_t *field, lane_t who, lane_t delta) {
+    for (int p = 0; p < MAX_PLAYERS; p++) field[p] += delta & (who == p);
+}
+
+static inline void lane_player_set(lane_t *field, lane_t who, lane_t mask, lane_t v) {
+    for (int p = 0; p < MAX_PLAYERS; p++) field[p] = lane_blend(mask & (who == p), v, field[p]);
+}
+
+// 对 mask 中的通道推进随机数，返回 [0, n) 的随机整数，与 rng_range 一致
+static inline lane_t lane_rng_range(ulane_t *rng, lane_t mask, int n) {
+    ulane_t x = *rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *rng = (ulane_t)lane_blend(mask, (lane_t)x, (lane_t)*rng);
+    return (lane_t)(((x >> 16) * (uint32_t)n) >> 16);
+}
+
+// 所有通道同时进行一个回合，对应标量引擎的 auto_turn
+void sim_lanes_turn(SimLanes *L, const SimBoard *b, lane_t lane_id) {
+    lane_t active = (L->game_over == 0) & (L->turns < SIM_MAX_TURNS);
+    L->turns -= active;
+    lane_t cp = L->current;
+    
+    // 住院或监禁：本回合跳过
+    lane_t in_hospital = active & (lane_player(L->hospitalized, cp) > 0);
+    lane_player_add(L->hospitalized, cp, in_hospital);
+    lane_t in_prison = active & ~in_hospital & (lane_player(L->imprisoned, cp) > 0);
+    lane_player_add(L->imprisoned, cp, in_prison);
+    lane_t play = active & ~in_hospital & ~in_prison;
+    
+    // 财神附身递减
+    lane_t god = lane_player(L->god_mode, cp);
+    god += play & (god > 0);
+    lane_player_set(L->god_mode, cp, play, god);
+    
+    // 回合开始放置炸弹
+    lane_t pos = lane_player(L->position, cp);
+    lane_t bombs = lane_player(L->bombs, cp);
+    lane_t use_bomb = play & (bombs > 0);
+    bombs += use_bomb;
+    lane_t target = pos + SIM_BOMB_DISTANCE;
+    target -= TOTAL_CELLS & (target >= TOTAL_CELLS);
+    lane_set_cell(L->item, target, (lane_t){0} + 3, use_bomb);
+    
+    // 掷骰子移动
+    pos += (lane_rng_range(&L->rng, play, 6) + 1) & play;
+    pos -= TOTAL_CELLS & (pos >= TOTAL_CELLS);
+    lane_player_set(L->position, cp, play, pos);
+    
+    lane_t type = lane_gather(b->type, pos);
+    lane_t price = lane_gather(b->price, pos);
+    lane_t toll = lane_gather(b->toll, pos);
+    lane_t owner = lane_cell(L->owner, pos, lane_id);
+    lane_t level = lane_cell(L->level, pos, lane_id);
+    lane_t money = lane_player(L->money, cp);
+    lane_t points = lane_player(L->points, cp);
+    lane_t money_delta = {0};
+    lane_t points_delta = {0};
+    
+    // 空地：购买、升级或支付过路费
+    lane_t land = play & (type == 'O');
+    lane_t buy = land & (owner == -1) & (money - price >= SIM_RESERVE);
+    lane_t upgrade = land & (owner == cp) & (level < 3) & (money - price >= SIM_RESERVE);
+    money_delta -= price & (buy | upgrade);
+    lane_set_cell(L->owner, pos, cp, buy);
+    lane_set_cell(L->level, pos, level + 1, upgrade);
+    
+    lane_t rent = land & (owner >= 0) & (owner != cp);
+    lane_t owner_away = (lane_player(L->hospitalized, owner) > 0) | (lane_player(L->imprisoned, owner) > 0);
+    lane_t fee = toll * (level + 1);
+    lane_t charged = rent & (god <= 0) & ~owner_away;
+    lane_t pay = charged & (money >= fee);
+    lane_t broke = charged & (money < fee);
+    money_delta -= fee & pay;
+    lane_player_add(L->money, owner, fee & pay);
+    lane_player_set(L->bankrupt, cp, broke, (lane_t){0} - 1);
+    L->game_over |= broke;
+    
+    // 道具屋：买炸弹；不买时不触发格子上的道具
+    lane_t shop = play & (type == 'T');
+    lane_t buy_bomb = shop & (points >= 50) & (bombs < MAX_ITEMS);
+    points_delta -= 50 & buy_bomb;
+    bombs -= buy_bomb;
+    lane_player_set(L->bombs, cp, play, bombs);
+    
+    // 礼品屋
+    lane_t gift = play & (type == 'G');
+    lane_t g = lane_rng_range(&L->rng, gift, 3);
+    money_delta += 2000 & gift & (g == 0);
+    points_delta += 200 & gift & (g == 1);
+    lane_player_set(L->god_mode, cp, gift & (g == 2), (lane_t){0} + 5);
+    
+    // 魔法屋
+    lane_t magic = play & (type == 'M');
+    lane_t m = lane_rng_range(&L->rng, magic, 3);
+    money_delta += 1000 & magic & (m == 0);
+    points_delta += 100 & magic & (m == 1);
+    money_delta -= 500 & magic & (m == 2);
+    
+    // 矿地
+    lane_t mine = play & (type == '$');
+    points_delta += (20 + lane_rng_range(&L->rng, mine, 80)) & mine;
+    
+    lane_player_add(L->money, cp, money_delta);
+    lane_player_add(L->points, cp, points_delta);
+    
+    // 触发格子上的道具
+    lane_t trigger = play & ~(shop & ~buy_bomb);
+    lane_t item = lane_cell(L->item, pos, lane_id);
+    lane_player_set(L->hospitalized, cp, trigger & (item == 3), (lane_t){0} + 3);
+    lane_set_cell(L->item, pos, (lane_t){0}, trigger & (item != 0));
+    
+    // 回合结束：检查破产并切换玩家
+    lane_t negative = play & (lane_player(L->money, cp) < 0);
+    lane_player_set(L->bankrupt, cp, negative, (lane_t){0} - 1);
+    L->game_over |= negative;
+    lane_t next = cp + 1;
+    next &= ~(next == MAX_PLAYERS);
+    L->current = lane_blend(active, next, cp);
+}
+
+// 用 SIMD 同时模拟 SIM_LANES 局
+void sim_batch(const SimBoard *b, const uint32_t *seeds, SimResult *out) {
+    SimLanes L;
+    lane_t lane_id;
+    
+    memset(&L, 0, sizeof(L));
+    for (int l = 0; l < SIM_LANES; l++) {
+        lane_id[l] = l;
+        L.rng[l] = seeds[l] ? seeds[l] : 2463534242u;
+    }
+    for (int p = 0; p < MAX_PLAYERS; p++) {
+        L.money[p] += 10000;
+        L.points[p] += 500;
+    }
+    for (int pos = 0; pos < TOTAL_CELLS; pos++) {
+        L.owner[pos] -= 1;
+    }
+    
+    lane_t done = {0};
+    for (;;) {
+        done = (L.game_over != 0) | (L.turns >= SIM_MAX_TURNS);
+        int all_done = 1;
+        for (int l = 0; l < SIM_LANES; l++) all_done &= done[l] != 0;
+        if (all_done) break;
+        sim_lanes_turn(&L, b, lane_id);
+    }
+    
+    for (int l = 0; l < SIM_LANES; l++) {
+        SimResult *r = &out[l];
+        int worth[MAX_PLAYERS];
+        r->turns = L.turns[l];
+        r->winner = 0;
+        for (int p = 0; p < MAX_PLAYERS; p++) {
+            r->money[p] = L.money[p][l];
+            worth[p] = L.money[p][l] > 0 ? L.money[p][l] : 0;
+            for (int pos = 0; pos < TOTAL_CELLS; pos++) {
+                if (L.owner[pos][l] == p) worth[p] += b->price[pos] * (L.level[pos][l] + 1);
+            }
+            if (L.bankrupt[p][l]) worth[p] = 0;
+            if (worth[p] > worth[r->winner]) r->winner = p;
+        }
+    }
+}
+
+uint32_t sim_seed(int game) {
+    return (uint32_t)(game + 1) * 2654435761u;
+}
+
+// 对比标量引擎与 SIMD 批量模拟的速度，并逐局核对结果
+void sim_benchmark(int games) {
+    games = (games + SIM_LANES - 1) / SIM_LANES * SIM_LANES;
+    SimResult *scalar = malloc(games * sizeof(SimResult));
+    SimResult *lanes = malloc(games * sizeof(SimResult));
+    uint32_t *seeds = malloc(games * sizeof(uint32_t));
+    if (!scalar || !lanes || !seeds) {
+        perror("malloc");
+        exit(1);
+    }
+    
+    quiet = 1;
+    sim_policy = greedy_policy;
+    init_map();
+    SimBoard board;
+    sim_board_from_map(&board);
+    for (int g = 0; g < games; g++) {
+        seeds[g] = sim_seed(g);
+    }
+    
+    double t0 = now_ms();
+    for (int g = 0; g < games; g++) {
+        sim_scalar_game(seeds[g], &scalar[g]);
+    }
+    double t1 = now_ms();
+    for (int g = 0; g < games; g += SIM_LANES) {
+        sim_batch(&board, &seeds[g], &lanes[g]);
+    }
+    double t2 = now_ms();
+    
+    int mismatches = 0;
+    long turns = 0;
+    for (int g = 0; g < games; g++) {
+        if (memcmp(&scalar[g], &lanes[g], sizeof(SimResult)) != 0) mismatches++;
+        turns += scalar[g].turns;
+    }
+    
+    printf("模拟 %d 局, 平均 %.1f 回合\n", games, (double)turns / games);
+    printf("标量引擎:        %10.0f 局/秒\n", games / ((t1 - t0) / 1000.0));
+    printf("SIMD (%2d 通道):  %10.0f 局/秒 (%.2fx)\n", SIM_LANES,
+           games / ((t2 - t1) / 1000.0), (t1 - t0) / (t2 - t1));
+    printf("结果不一致: %d 局\n", mismatches);
+    
+    free(scalar);
+    free(lanes);
+    free(seeds);
+}
+
+// ===================== 落点概率 (马尔可夫链) =====================
+// 状态为 (格子, 剩余停留回合)。自由状态每回合掷 d6 前进 1-6 格，落在需要停留的
+// 格子上时依次经过 hold 个停留状态。转移矩阵按目标状态压缩存储（记录每个状态的来源），
+// 计算时按状态顺序拉取：来源都在前面至多6格以内，读取的数据集中在一小段内存中，
+// 顺序扫描已经足够，所以没有再做分块。
+// 每个状态的流入概率之和都是 1（落点状态来自 6 个 1/6，停留状态来自下一个停留状态），
+// 矩阵是双随机的，平稳分布就是所有状态上的均匀分布，不需要迭代求解；
+// 幂迭代在环形地图上要 O(格子数^2) 步才能混合，大地图上根本不收敛。
+// 大地图由当前地图的格子类型循环平铺而成。
+
+int hold_hospital = 0; // 落在医院时停留的回合数，当前规则只是路过
+int hold_prison = 0;   // 落在监狱时停留的回合数
+
+typedef struct {
+    int cells;         // 格子数
+    int states;        // 状态数
+    char *type;        // 每个格子的类型
+    int *first_state;  // 每个格子的自由状态编号，停留状态紧随其后 (cells + 1 项)
+    int *in_start;     // 每个状态的来源区间 (states + 1 项)
+    int *in_from;      // 来源状态
+    double *in_prob;   // 转移概率
+} MarkovChain;
+
+int cell_hold(char type) {
+    if (type == 'H') return hold_hospital;
+    if (type == 'P') return hold_prison;
+    return 0;
+}
+
+void *xmalloc(size_t size) {
+    void *p = malloc(size);
+    if (p == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    return p;
+}
+
+void *xcalloc(size_t count, size_t size) {
+    void *p = calloc(count, size);
+    if (p == NULL) {
+        perror("calloc");
+        exit(1);
+    }
+    return p;
+}
+
+// 构建 cells 个格子的转移矩阵
+void markov_build(MarkovChain *mc, int cells) {
+    init_map();
+    char layout[TOTAL_CELLS];
+    for (int pos = 0; pos < TOTAL_CELLS; pos++) {
+        int row, col;
+        position_to_coord(pos, &row, &col);
+        layout[pos] = map[row][col].type;
+    }
+    
+    mc->cells = cells;
+    mc->type = xmalloc(cells);
+    mc->first_state = xmalloc((cells + 1) * sizeof(int));
+    mc->states = 0;
+    for (int i = 0; i < cells; i++) {
+        mc->type[i] = layout[i % TOTAL_CELLS];
+        mc->first_state[i] = mc->states;
+        mc->states += 1 + cell_hold(mc->type[i]);
+    }
+    mc->first_state[cells] = mc->states;
+    
+    mc->in_start = xmalloc((mc->states + 1) * sizeof(int));
+    mc->in_from = xmalloc((size_t)mc->states * 6 * sizeof(int));
+    mc->in_prob = xmalloc((size_t)mc->states * 6 * sizeof(double));
+    
+    int nnz = 0;
+    for (int j = 0; j < cells; j++) {
+        int hold = mc->first_state[j + 1] - mc->first_state[j] - 1;
+        for (int k = 0; k <= hold; k++) {
+            mc->in_start[mc->first_state[j] + k] = nnz;
+            if (k == hold) {
+                // 落点状态：来自前面 1-6 格的自由状态
+                for (int d = 6; d >= 1; d--) {
+                    int from = ((j - d) % cells + cells) % cells;
+                    mc->in_from[nnz] = mc->first_state[from];
+                    mc->in_prob[nnz] = 1.0 / 6;
+                    nnz++;
+                }
+            } else {
+                // 停留状态倒数一回合
+                mc->in_from[nnz] = mc->first_state[j] + k + 1;
+                mc->in_prob[nnz] = 1.0;
+                nnz++;
+            }
+        }
+    }
+    mc->in_start[mc->states] = nnz;
+}
+
+void markov_free(MarkovChain *mc) {
+    free(mc->type);
+    free(mc->first_state);
+    free(mc->in_start);
+    free(mc->in_from);
+    free(mc->in_prob);
+}
+
+// y = x * P，只计算 [lo, hi) 范围的状态，返回该范围内的 L1 变化量
+double markov_step(const MarkovChain *mc, const double *x, double *y, int lo, int hi) {
+    double diff = 0;
+    for (int s = lo; s < hi; s++) {
+        double sum = 0;
+        for (int e = mc->in_start[s]; e < mc->in_start[s + 1]; e++) {
+            sum += x[mc->in_from[e]] * mc->in_prob[e];
+        }
+        diff += fabs(sum - x[s]);
+        y[s] = sum;
+    }
+    return diff;
+}
+
+// 每个格子的落点概率：流入其落点状态的概率
+void markov_landing(const MarkovChain *mc, const double *x, double *landing) {
+    for (int j = 0; j < mc->cells; j++) {
+        int s = mc->first_state[j + 1] - 1;
+        double sum = 0;
+        for (int e = mc->in_start[s]; e < mc->in_start[s + 1]; e++) {
+            sum += x[mc->in_from[e]] * mc->in_prob[e];
+        }
+        landing[j] = sum;
+    }
+}
+
+// 平稳分布：双随机矩阵的平稳分布是均匀分布。
+// 返回对构建出的矩阵做一步转移后的 L1 变化量，用来校验矩阵确实是双随机的
+double markov_stationary(const MarkovChain *mc, double *pi) {
+    double *next = xmalloc((size_t)mc->states * sizeof(double));
+    for (int s = 0; s < mc->states; s++) {
+        pi[s] = 1.0 / mc->states;
+    }
+    double residual = markov_step(mc, pi, next, 0, mc->states);
+    free(next);
+    return residual;
+}
+
+// 从起点出发的前 turns 回合内，每个格子的期望落点次数
+void markov_transient(const MarkovChain *mc, int turns, double *expected) {
+    // 两个缓冲区都从零开始：每回合只写到 hi 为止，更远的状态（包括绕回起点的来源）必须保持为零
+    double *x = xcalloc(mc->states, sizeof(double));
+    double *y = xcalloc(mc->states, sizeof(double));
+    memset(expected, 0, (size_t)mc->cells * sizeof(double));
+    x[0] = 1.0;
+    
+    for (int t = 1; t <= turns; t++) {
+        // 第 t 回合后概率只分布在前 6t 格（加上停留状态）内
+        long reach = 6l * t + 1;
+        int cells = reach < mc->cells ? (int)reach : mc->cells;
+        int hi = mc->first_state[cells];
+        markov_step(mc, x, y, 0, hi);
+        for (int j = 0; j < cells; j++) {
+            int s = mc->first_state[j + 1] - 1;
+            double sum = 0;
+            for (int e = mc->in_start[s]; e < mc->in_start[s + 1]; e++) {
+                sum += x[mc->in_from[e]] * mc->in_prob[e];
+            }
+            expected[j] += sum;
+        }
+        double *tmp = x;
+        x = y;
+        y = tmp;
+    }
+    
+    free(x);
+    free(y);
+}
+
+// 求解并输出落点概率；当前地图逐格输出，大地图输出汇总
+void markov_report(int cells, int turns) {
+    if (cells < 7) cells = 7;
+    
+    MarkovChain mc;
+    double t0 = now_ms();
+    markov_build(&mc, cells);
+    double t1 = now_ms();
+    
+    double *pi = xmalloc((size_t)mc.states * sizeof(double));
+    double *landing = xmalloc((size_t)cells * sizeof(double));
+    double residual = markov_stationary(&mc, pi);
+    markov_landing(&mc, pi, landing);
+    double t2 = now_ms();
+    
+    double *expected = NULL;
+    if (turns > 0) {
+        expected = xmalloc((size_t)cells * sizeof(double));
+        markov_transient(&mc, turns, expected);
+    }
+    double t3 = now_ms();
+    
+    // 落点概率按一次移动归一化，停留概率为每回合所在格子的比例
+    double moves = 0;
+    for (int j = 0; j < cells; j++) {
+        moves += landing[j];
+    }
+    
+    printf("格子 %d, 状态 %d, 非零元 %d (医院停留 %d 回合, 监狱停留 %d 回合)\n",
+           cells, mc.states, mc.in_start[mc.states], hold_hospital, hold_prison);
+    printf("构建 %.1f ms, 平稳分布为均匀分布 (校验残差 %.2e, %.1f ms)", t1 - t0, residual, t2 - t1);
+    if (turns > 0) printf(", 前 %d 回合期望 %.1f ms", turns, t3 - t2);
+    printf("\n");
+    
+    if (cells == TOTAL_CELLS) {
+        printf("位置  坐标     类型  落点概率  停留概率%s\n", turns > 0 ? "  期望落点次数" : "");
+        for (int j = 0; j < cells; j++) {
+            int row, col;
+            position_to_coord(j, &row, &col);
+            double stay = 0;
+            for (int s = mc.first_state[j]; s < mc.first_state[j + 1]; s++) {
+                stay += pi[s];
+            }
+            printf("%4d  (%d,%2d)   %c    %6.3f%%   %6.3f%%", j, row, col, mc.type[j],
+                   100.0 * landing[j] / moves, 100.0 * stay);
+            if (turns > 0) printf("   %8.3f", expected[j]);
+            printf("\n");
+        }
+    } else {
+        double lo = 1, hi = 0;
+        for (int j = 0; j < cells; j++) {
+            double p = landing[j] / moves;
+            if (p < lo) lo = p;
+            if (p > hi) hi = p;
+        }
+        printf("落点概率: 最小 %.6e, 最大 %.6e (均匀为 %.6e)\n", lo, hi, 1.0 / cells);
+    }
+    
+    free(pi);
+    free(landing);
+    free(expected);
+    markov_free(&mc);
+}
+
+// ===================== 价格与过路费参数扫描 =====================
+// 每个参数点用 SIMD 批量模拟跑固定数量的对局（所有参数点使用同一组种子，便于比较），
+// 多线程并行评估。结果按参数点缓存在内存中，并可保存到文件供下次运行复用。
+// 公平性指标：各座位胜率的极差，以及平均对局长度和达到回合上限的比例。
+
+#define SWEEP_CACHE_MIN 1024
+
+typedef struct {
+    Economy e;
+    int games;
+    int wins[MAX_PLAYERS];
+    int capped;   // 达到回合上限的局数
+    long turns;
+} SweepResult;
+
+int sweep_games = 1024;      // 每个参数点的对局数
+const char *sweep_cache_file = NULL;
+
+// 参数点结果缓存：开放寻址哈希表，所有线程共用一把锁
+SweepResult *sweep_cache;
+int sweep_cache_cap;
+int sweep_cache_len;
+pthread_mutex_t sweep_lock = PTHREAD_MUTEX_INITIALIZER;
+
+uint64_t economy_hash(const Economy *e) {
+    uint64_t h = 1469598103934665603ull;
+    const unsigned char *p = (const unsigned char *)e;
+    for (size_t i = 0; i < sizeof(Economy); i++) {
+        h = (h ^ p[i]) * 1099511628211ull;
+    }
+    return h;
+}
+
+// 查找参数点的槽位（调用方持有锁）
+SweepResult *sweep_slot(const Economy *e) {
+    uint64_t i = economy_hash(e) & (sweep_cache_cap - 1);
+    while (sweep_cache[i].games != 0 && memcmp(&sweep_cache[i].e, e, sizeof(Economy)) != 0) {
+        i = (i + 1) & (sweep_cache_cap - 1);
+    }
+    return &sweep_cache[i];
+}
+
+// 插入结果，装载率超过一半时扩容（调用方持有锁）
+void sweep_insert(const SweepResult *r) {
+    if (sweep_cache_len * 2 >= sweep_cache_cap) {
+        SweepResult *old = sweep_cache;
+        int old_cap = sweep_cache_cap;
+        sweep_cache_cap = old_cap ? old_cap * 2 : SWEEP_CACHE_MIN;
+        sweep_cache = calloc(sweep_cache_cap, sizeof(SweepResult));
+        if (sweep_cache == NULL) {
+            perror("calloc");
+            exit(1);
+        }
+        sweep_cache_len = 0;
+        for (int i = 0; i < old_cap; i++) {
+            if (old[i].games) {
+                *sweep_slot(&old[i].e) = old[i];
+                sweep_cache_len++;
+            }
+        }
+        free(old);
+    }
+    SweepResult *slot = sweep_slot(&r->e);
+    if (slot->games == 0) sweep_cache_len++;
+    *slot = *r;
+}
+
+int sweep_lookup(const Economy *e, SweepResult *out) {
+    int found = 0;
+    pthread_mutex_lock(&sweep_lock);
+    if (sweep_cache_cap) {
+        SweepResult *slot = sweep_slot(e);
+        if (slot->games) {
+            *out = *slot;
+            found = 1;
+        }
+    }
+    pthread_mutex_unlock(&sweep_lock);
+    return found;
+}
+
+// 从文件读取缓存，只接受对局数相同的记录
+void sweep_load_cache() {
+    FILE *f = fopen(sweep_cache_file, "r");
+    if (f == NULL) return;
+    
+    SweepResult r;
+    while (fscanf(f, "%d %d %d %d %d %d %d %d %d %d %d %d %d %d %ld",
+                  &r.e.price[0], &r.e.price[1], &r.e.price[2], &r.e.price[3],
+                  &r.e.toll[0], &r.e.toll[1], &r.e.toll[2], &r.e.toll[3],
+                  &r.games, &r.wins[0], &r.wins[1], &r.wins[2], &r.wins[3],
+                  &r.capped, &r.turns) == 15) {
+        if (r.games == sweep_games) sweep_insert(&r);
+    }
+    fclose(f);
+}
+
+void sweep_save_cache() {
+    FILE *f = fopen(sweep_cache_file, "w");
+    if (f == NULL) {
+        perror(sweep_cache_file);
+        return;
+    }
+    for (int i = 0; i < sweep_cache_cap; i++) {
+        const SweepResult *r = &sweep_cache[i];
+        if (r->games == 0) continue;
+        fprintf(f, "%d %d %d %d %d %d %d %d %d %d %d %d %d %d %ld\n",
+                r->e.price[0], r->e.price[1], r->e.price[2], r->e.price[3],
+                r->e.toll[0], r->e.toll[1], r->e.toll[2], r->e.toll[3],
+                r->games, r->wins[0], r->wins[1], r->wins[2], r->wins[3],
+                r->capped, r->turns);
+    }
+    fclose(f);
+}
+
+// 在当前线程评估一个参数点
+void sweep_evaluate(const Economy *e, SweepResult *r) {
+    SimBoard board;
+    SimResult results[SIM_LANES];
+    uint32_t seeds[SIM_LANES];
+    
+    economy = *e;
+    init_map();
+    sim_board_from_map(&board);
+    
+    memset(r, 0, sizeof(*r));
+    r->e = *e;
+    for (int g = 0; g < sweep_games; g += SIM_LANES) {
+        for (int l = 0; l < SIM_LANES; l++) {
+            seeds[l] = sim_seed(g + l);
+        }
+        sim_batch(&board, seeds, results);
+        for (int l = 0; l < SIM_LANES && g + l < sweep_games; l++) {
+            r->games++;
+            r->wins[results[l].winner]++;
+            r->turns += results[l].turns;
+            if (results[l].turns >= SIM_MAX_TURNS) r->capped++;
+        }
+    }
+}
+
+double sweep_spread(const SweepResult *r) {
+    int lo = r->wins[0], hi = r->wins[0];
+    for (int i = 1; i < MAX_PLAYERS; i++) {
+        if (r->wins[i] < lo) lo = r->wins[i];
+        if (r->wins[i] > hi) hi = r->wins[i];
+    }
+    return (double)(hi - lo) / r->games;
+}
+
+// 越小越好：座位胜率极差，加上打不完的对局比例
+double sweep_score(const SweepResult *r) {
+    return sweep_spread(r) + 0.5 * r->capped / r->games;
+}
+
+// 一批待评估的参数点，由各线程按序领取
+typedef struct {
+    const Economy *points;
+    SweepResult *results;
+    int n;
+    _Atomic int next;
+    _Atomic int computed;
+} SweepJob;
+
+void *sweep_worker(void *arg) {
+    SweepJob *job = arg;
+    quiet = 1;
+    int i;
+    while ((i = atomic_fetch_add(&job->next, 1)) < job->n) {
+        if (sweep_lookup(&job->points[i], &job->results[i])) continue;
+        sweep_evaluate(&job->points[i], &job->results[i]);
+        atomic_fetch_add(&job->computed, 1);
+        pthread_mutex_lock(&sweep_lock);
+        sweep_insert(&job->results[i]);
+        pthread_mutex_unlock(&sweep_lock);
+    }
+    return NULL;
+}
+
+// 用所有CPU并行评估一批参数点，返回实际计算（未命中缓存）的个数
+int sweep_run(const Economy *points, SweepResult *results, int n) {
+    int threads = bot_threads > 0 ? bot_threads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) threads = 1;
+    if (threads > MAX_SEARCH_THREADS) threads = MAX_SEARCH_THREADS;
+    
+    SweepJob job = { points, results, n, 0, 0 };
+    pthread_t tids[MAX_SEARCH_THREADS];
+    int started = 0;
+    for (int t = 0; t < threads; t++) {
+        if (pthread_create(&tids[t], NULL, sweep_worker, &job) != 0) break;
+        started++;
+    }
+    if (started == 0) sweep_worker(&job);
+    for (int t = 0; t < started; t++) {
+        pthread_join(tids[t], NULL);
+    }
+    return job.computed;
+}
+
+void sweep_print(const SweepResult *r) {
+    printf("价格 %3d/%3d/%3d/%3d 过路费 %3d/%3d/%3d/%3d | 胜率",
+           r->e.price[0], r->e.price[1], r->e.price[2], r->e.price[3],
+           r->e.toll[0], r->e.toll[1], r->e.toll[2], r->e.toll[3]);
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        printf(" %5.1f%%", 100.0 * r->wins[i] / r->games);
+    }
+    printf(" | 极差 %5.1f%% | 平均 %6.1f 回合 | 未完 %4.1f%%\n",
+           100.0 * sweep_spread(r), (double)r->turns / r->games, 100.0 * r->capped / r->games);
+}
+
+int sweep_compare(const void *a, const void *b) {
+    double sa = sweep_score(a), sb = sweep_score(b);
+    return (sa > sb) - (sa < sb);
+}
+
+// 某一边上是否有可购买的空地（左侧一列全是矿地，价格不起作用）
+int side_has_land(int side) {
+    init_map();
+    for (int i = 0; i < MAP_ROWS; i++) {
+        for (int j = 0; j < MAP_COLS; j++) {
+            int s = i == 0 ? SIDE_TOP : i == MAP_ROWS - 1 ? SIDE_BOTTOM :
+                    j == 0 ? SIDE_LEFT : j == MAP_COLS - 1 ? SIDE_RIGHT : -1;
+            if (s == side && map[i][j].type == 'O') return 1;
+        }
+    }
+    return 0;
+}
+
+// 网格搜索：有空地的每一边价格取 lo..hi (步长 step)，过路费为价格乘以各个比例
+int sweep_grid(int lo, int hi, int step, const double *ratios, int n_ratios, SweepResult **out) {
+    int n_prices = (hi - lo) / step + 1;
+    int dims[4];
+    int per_ratio = 1;
+    for (int side = 0; side < 4; side++) {
+        dims[side] = side_has_land(side) ? n_prices : 1;
+        per_ratio *= dims[side];
+    }
+    int n = per_ratio * n_ratios;
+    Economy *points = xmalloc(n * sizeof(Economy));
+    
+    int k = 0;
+    for (int r = 0; r < n_ratios; r++) {
+        for (int idx = 0; idx < per_ratio; idx++) {
+            int rest = idx;
+            points[k] = economy;
+            for (int side = 0; side < 4; side++) {
+                if (dims[side] == 1) continue;
+                points[k].price[side] = lo + (rest % n_prices) * step;
+                points[k].toll[side] = (int)(points[k].price[side] * ratios[r] / 10 + 0.5) * 10;
+                rest /= n_prices;
+            }
+            k++;
+        }
+    }
+    
+    *out = xmalloc(n * sizeof(SweepResult));
+    sweep_run(points, *out, n);
+    free(points);
+    return n;
+}
+
+// 遗传搜索：锦标赛选择、均匀交叉，按10元取整变异
+int sweep_genetic(int population, int generations, SweepResult **out) {
+    Economy *pop = xmalloc(population * sizeof(Economy));
+    Economy *next = xmalloc(population * sizeof(Economy));
+    SweepResult *results = xmalloc(population * sizeof(SweepResult));
+    
+    int land[4];
+    for (int side = 0; side < 4; side++) {
+        land[side] = side_has_land(side);
+    }
+    
+    // 第一代：默认参数及其随机扰动
+    Economy base = economy;
+    for (int i = 0; i < population; i++) {
+        pop[i] = base;
+        if (i == 0) continue;
+        for (int side = 0; side < 4; side++) {
+            if (!land[side]) continue;
+            pop[i].price[side] = 50 + rng_range(60) * 10;
+            pop[i].toll[side] = 10 + rng_range(pop[i].price[side] / 10) * 10;
+        }
+    }
+    
+    for (int gen = 0; gen < generations; gen++) {
+        double t0 = now_ms();
+        int computed = sweep_run(pop, results, population);
+        qsort(results, population, sizeof(SweepResult), sweep_compare);
+        printf("第 %2d 代: 计算 %d 个新参数点 (%.0f ms), 最优 ", gen + 1, computed, now_ms() - t0);
+        sweep_print(&results[0]);
+        
+        // 保留前两名，其余由锦标赛选出的父母交叉变异产生
+        next[0] = results[0].e;
+        next[1] = results[1 % population].e;
+        for (int i = 2; i < population; i++) {
+            int a = rng_range(population), b = rng_range(population);
+            int c = rng_range(population), d = rng_range(population);
+            const Economy *pa = &results[a < b ? a : b].e;
+            const Economy *pb = &results[c < d ? c : d].e;
+            next[i] = base;
+            for (int side = 0; side < 4; side++) {
+                if (!land[side]) continue;
+                next[i].price[side] = rng_range(2) ? pa->price[side] : pb->price[side];
+                next[i].toll[side] = rng_range(2) ? pa->toll[side] : pb->toll[side];
+                if (rng_range(5) == 0) next[i].price[side] += (rng_range(11) - 5) * 10;
+                if (rng_range(5) == 0) next[i].toll[side] += (rng_range(11) - 5) * 10;
+                if (next[i].price[side] < 10) next[i].price[side] = 10;
+                if (next[i].toll[side] < 10) next[i].toll[side] = 10;
+            }
+        }
+        Economy *tmp = pop;
+        pop = next;
+        next = tmp;
+    }
+    
+    free(pop);
+    free(next);
+    *out = results;
+    return population;
+}
+
+// 参数扫描入口：mode 为 "grid" 或 "ga"
+void sweep_main(const char *mode, int lo, int hi, int step, const char *ratio_list,
+                int population, int generations, int top) {
+    if (sweep_cache_file) sweep_load_cache();
+    int cached = sweep_cache_len;
+    
+    // 当前参数作为参照
+    SweepResult current;
+    Economy defaults = economy;
+    sweep_run(&defaults, &current, 1);
+    economy = defaults;
+    printf("当前参数 (%d 局): ", sweep_games);
+    sweep_print(&current);
+    
+    double t0 = now_ms();
+    SweepResult *results;
+    int n;
+    if (strcmp(mode, "ga") == 0) {
+        rng_seed((uint32_t)time(NULL));
+        n = sweep_genetic(population, generations, &results);
+    } else {
+        double ratios[16];
+        int n_ratios = 0;
+        char buf[256];
+        snprintf(buf, sizeof(buf), "%s", ratio_list);
+        for (char *tok = strtok(buf, ","); tok && n_ratios < 16; tok = strtok(NULL, ",")) {
+            ratios[n_ratios++] = atof(tok);
+        }
+        if (step <= 0 || hi < lo || n_ratios == 0) {
+            fprintf(stderr, "无效的网格参数\n");
+            return;
+        }
+        n = sweep_grid(lo, hi, step, ratios, n_ratios, &results);
+        qsort(results, n, sizeof(SweepResult), sweep_compare);
+    }
+    economy = defaults;
+    
+    printf("评估 %d 个参数点, 用时 %.1f 秒, 缓存共 %d 项 (运行前已有 %d 项)\n",
+           n, (now_ms() - t0) / 1000.0, sweep_cache_len, cached);
+    printf("最公平的 %d 组参数 (顶部/底部/左侧/右侧):\n", top < n ? top : n);
+    for (int i = 0, shown = 0; shown < top && i < n; i++) {
+        // 遗传搜索的种群中可能有重复的参数点
+        if (i > 0 && memcmp(&results[i].e, &results[i - 1].e, sizeof(Economy)) == 0) continue;
+        sweep_print(&results[i]);
+        shown++;
+    }
+    
+    if (sweep_cache_file) sweep_save_cache();
+    free(results);
+}
+
+// ===================== 检查点 =====================
+// 长时间的模拟和服务器对局定期写检查点：fork 出子进程，由子进程把写时复制得到的快照
+// 写到 PATH.tmp 再改名为 PATH，父进程立即继续，游戏循环看到的停顿只有 fork 本身。
+// 上一个子进程还没写完时跳过这一次检查点。
+
+#include <sys/wait.h>
+#include <errno.h>
+
+#define CHECKPOINT_MAGIC "RICHCKPT"
+#define CHECKPOINT_MASS 1
+#define CHECKPOINT_SERVER 2
+
+typedef struct {
+    char magic[8];
+    uint32_t kind;
+    uint32_t size;    // 记录结构的大小，用于识别不兼容的检查点
+} CheckpointHeader;
+
+const char *checkpoint_path = NULL;
+int checkpoint_ms = 1000;           // 检查点间隔
+pid_t checkpoint_child = 0;         // 正在写检查点的子进程
+long checkpoint_taken;
+long checkpoint_skipped;
+long checkpoint_failed;
+double checkpoint_fork_total;       // fork 累计用时（毫秒）
+double checkpoint_fork_max;
+
+int checkpoint_write(int fd, const void *data, size_t len) {
+    const char *p = data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// 读满 len 字节返回 1，文件在记录开头结束返回 0，出错或记录不完整返回 -1
+int checkpoint_read(int fd, void *data, size_t len) {
+    char *p = data;
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = read(fd, p + got, len - got);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return -1;
+        if (n == 0) return got == 0 ? 0 : -1;
+        got += n;
+    }
+    return 1;
+}
+
+// 回收写完的子进程，子进程仍在写时返回 0
+int checkpoint_reap(int block) {
+    if (checkpoint_child <= 0) return 1;
+    int status;
+    pid_t r = waitpid(checkpoint_child, &status, block ? 0 : WNOHANG);
+    if (r == 0) return 0;
+    if (r < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) checkpoint_failed++;
+    checkpoint_child = 0;
+    return 1;
+}
+
+// fork 一个子进程，由 save 在子进程里写出检查点的内容。返回 1 表示已开始写
+int checkpoint_fork(uint32_t kind, uint32_t size, int (*save)(int fd, void *arg), void *arg) {
+    if (!checkpoint_reap(0)) {
+        checkpoint_skipped++;
+        return 0;
+    }
+    
+    double start = now_ms();
+    pid_t pid = fork();
+    if (pid == 0) {
+        // 子进程只做系统调用，不碰 stdio 和其他线程可能持有的锁
+        char tmp[4096];
+        snprintf(tmp, sizeof(tmp), "%s.tmp", checkpoint_path);
+        CheckpointHeader h = { CHECKPOINT_MAGIC, kind, size };
+        int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        int ok = fd >= 0 && checkpoint_write(fd, &h, sizeof(h)) == 0 && save(fd, arg) == 0
+                 && fsync(fd) == 0;
+        if (fd >= 0) close(fd);
+        _exit(ok && rename(tmp, checkpoint_path) == 0 ? 0 : 1);
+    }
+    double cost = now_ms() - start;
+    if (pid < 0) {
+        checkpoint_failed++;
+        return 0;
+    }
+    
+    checkpoint_child = pid;
+    checkpoint_taken++;
+    checkpoint_fork_total += cost;
+    if (cost > checkpoint_fork_max) checkpoint_fork_max = cost;
+    return 1;
+}
+
+// 打开检查点文件并核对文件头，返回文件描述符，失败时返回 -1
+int checkpoint_open(const char *path, uint32_t kind, uint32_t size) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    CheckpointHeader h;
+    if (checkpoint_read(fd, &h, sizeof(h)) != 1 || memcmp(h.magic, CHECKPOINT_MAGIC, 8) != 0
+        || h.kind != kind || h.size != size) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    return fd;
+}
+
+void checkpoint_report(FILE *out) {
+    if (checkpoint_taken == 0) return;
+    fprintf(out, "检查点: 写出 %ld 次, 跳过 %ld 次, 失败 %ld 次, fork 平均 %.3f 毫秒, 最长 %.3f 毫秒\n",
+            checkpoint_taken, checkpoint_skipped, checkpoint_failed,
+            checkpoint_fork_total / checkpoint_taken, checkpoint_fork_max);
+}
+
+// ===================== 大规模模式 =====================
+// 上千名玩家在一张放大的地图上按批量模拟的规则和 greedy_policy 进行游戏，用于压测规则。
+// 玩家表按字段分开存放（SoA），每个格子维护站在上面的玩家链表，
+// 住院的玩家挂在时间轮上（每个槽覆盖一轮），能行动的玩家记在两级位图中，
+// 每回合的调度开销与玩家数量无关。破产的玩家交还地产后退出，游戏继续。
+// 每回合的骰子由对局种子和回合序号决定，因此回合可以先在工作线程上按快照推演（推测执行），
+// 再按顺序提交：读过的格子或玩家已被前面的回合改写时，该回合在提交时重新执行，结果与顺序执行相同。
+
+#define MASS_ROUNDS 100   // 默认进行的轮数
+
+typedef struct {
+    int players;
+    int cells;
+    
+    // 玩家表
+    int32_t *money;
+    int32_t *points;
+    int32_t *position;
+    int32_t *hospital_until;  // 到期回合序号，含义与 Player 相同
+    int32_t *god_until;
+    uint8_t *bombs;
+    uint8_t *bankrupt;
+    int32_t *occ_next;        // 同一格子上的下一个/上一个玩家
+    int32_t *occ_prev;
+    int32_t *owned_head;      // 玩家拥有的第一块地
+    
+    // 地图：格子类型、价格和过路费取自标准地图（位置对 TOTAL_CELLS 取模）
+    SimBoard base;
+    int32_t *owner;
+    int32_t *owned_next;      // 同一玩家拥有的下一块地
+    int32_t *occ_head;        // 格子上的第一个玩家
+    int32_t *occ_count;
+    uint8_t *level;
+    uint8_t *item;
+    
+    // 调度
+    TimerWheel wheel;
+    int32_t *wheel_next;
+    int32_t *wheel_prev;
+    int32_t *wheel_due;
+    uint64_t *ready;          // 能行动的玩家
+    uint64_t *ready_summary;  // 第二级：ready 中每个非零字一位
+    int turn_number;
+    int current;
+    int alive;
+    
+    // 推测执行：本批回合中被改写过的格子和玩家标记为当前批次号
+    uint64_t seed;
+    uint32_t epoch;
+    uint32_t *cell_stamp;
+    uint32_t *player_stamp;
+    
+    double next_checkpoint;   // 下一次写检查点的时间，0 表示不写
+    
+    // 统计
+    long turns_played;
+    long bankruptcies;
+    long hospital_stays;
+    long replayed;
+} MassGame;
+
+MassGame *mass; // wheel_expire 的回调通过它找到当前对局
+
+void mass_mark_ready(int p) {
+    mass->ready[p >> 6] |= 1ull << (p & 63);
+    mass->ready_summary[p >> 12] |= 1ull << ((p >> 6) & 63);
+}
+
+void mass_clear_ready(MassGame *g, int p) {
+    g->ready[p >> 6] &= ~(1ull << (p & 63));
+    if (g->ready[p >> 6] == 0) g->ready_summary[p >> 12] &= ~(1ull << ((p >> 6) & 63));
+}
+
+// 两级位图中从 from 开始的第一个能行动的玩家，没有时返回 -1
+int mass_ready_next(MassGame *g, int from) {
+    if (from >= g->players) return -1;
+    int word = from >> 6;
+    uint64_t w = g->ready[word] & (~0ull << (from & 63));
+    if (w) return (word << 6) + __builtin_ctzll(w);
+    
+    int words = (g->players + 63) >> 6;
+    for (int s = (word + 1) >> 6; s < (words + 63) >> 6; s++) {
+        uint64_t sum = g->ready_summary[s];
+        if (s == (word + 1) >> 6) sum &= ~0ull << ((word + 1) & 63);
+        if (sum) {
+            int i = (s << 6) + __builtin_ctzll(sum);
+            return (i << 6) + __builtin_ctzll(g->ready[i]);
+        }
+    }
+    return -1;
+}
+
+// 回合序号与行动的座位对玩家数同余，所以只需回合序号就能算出下一次轮到 p 的回合
+int mass_next_visit(const MassGame *g, int turn, int p) {
+    int n = g->players;
+    return turn + (p - turn % n + n - 1) % n + 1;
+}
+
+int mass_hospital_left(const MassGame *g, int turn, int p) {
+    int until = g->hospital_until[p];
+    if (until <= turn) return 0;
+    int nv = mass_next_visit(g, turn, p);
+    return until > nv ? (until - nv) / g->players : 0;
+}
+
+// until 由调用者给出，推演中的回合用它传入尚未写回的无敌期限
+int mass_god_left(const MassGame *g, int turn, int p, int until) {
+    if (until <= turn) return 0;
+    int nv = mass_next_visit(g, turn, p);
+    if (until < nv) return 0;
+    int left = (until - nv) / g->players + 1 - mass_hospital_left(g, turn, p);
+    return left > 0 ? left : 0;
+}
+
+void mass_occupy(MassGame *g, int p, int pos) {
+    g->position[p] = pos;
+    g->occ_prev[p] = -1;
+    g->occ_next[p] = g->occ_head[pos];
+    if (g->occ_head[pos] >= 0) g->occ_prev[g->occ_head[pos]] = p;
+    g->occ_head[pos] = p;
+    g->occ_count[pos]++;
+}
+
+void mass_leave(MassGame *g, int p) {
+    int pos = g->position[p];
+    if (g->occ_prev[p] >= 0) {
+        g->occ_next[g->occ_prev[p]] = g->occ_next[p];
+    } else {
+        g->occ_head[pos] = g->occ_next[p];
+    }
+    if (g->occ_next[p] >= 0) g->occ_prev[g->occ_next[p]] = g->occ_prev[p];
+    g->occ_count[pos]--;
+}
+
+void mass_free(MassGame *g) {
+    void *arrays[] = {
+        g->money, g->points, g->position, g->hospital_until, g->god_until, g->bombs,
+        g->bankrupt, g->occ_next, g->occ_prev, g->owned_head, g->owner, g->owned_next,
+        g->occ_head, g->occ_count, g->level, g->item, g->wheel_next, g->wheel_prev,
+        g->wheel_due, g->ready, g->ready_summary, g->cell_stamp, g->player_stamp
+    };
+    for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i++) {
+        free(arrays[i]);
+    }
+}
+
+// 分配并初始化对局，返回占用的字节数。spread 为真时玩家均匀分布在地图上出发
+size_t mass_init(MassGame *g, int players, int cells, uint64_t seed, int spread) {
+    memset(g, 0, sizeof(MassGame));
+    g->players = players;
+    g->cells = cells;
+    g->seed = seed;
+    int words = (players + 63) >> 6;
+    int summary = (words + 63) >> 6;
+    size_t per_player = 10 * sizeof(int32_t) + 2 * sizeof(uint8_t);
+    size_t per_cell = 5 * sizeof(int32_t) + 2 * sizeof(uint8_t);
+    
+    g->money = xmalloc(sizeof(int32_t) * players);
+    g->points = xmalloc(sizeof(int32_t) * players);
+    g->position = xmalloc(sizeof(int32_t) * players);
+    g->hospital_until = calloc(players, sizeof(int32_t));
+    g->god_until = calloc(players, sizeof(int32_t));
+    g->bombs = calloc(players, sizeof(uint8_t));
+    g->bankrupt = calloc(players, sizeof(uint8_t));
+    g->occ_next = xmalloc(sizeof(int32_t) * players);
+    g->occ_prev = xmalloc(sizeof(int32_t) * players);
+    g->owned_head = xmalloc(sizeof(int32_t) * players);
+    g->wheel_next = xmalloc(sizeof(int32_t) * players);
+    g->wheel_prev = xmalloc(sizeof(int32_t) * players);
+    g->wheel_due = xmalloc(sizeof(int32_t) * players);
+    g->owner = xmalloc(sizeof(int32_t) * cells);
+    g->owned_next = xmalloc(sizeof(int32_t) * cells);
+    g->occ_head = xmalloc(sizeof(int32_t) * cells);
+    g->occ_count = calloc(cells, sizeof(int32_t));
+    g->level = calloc(cells, sizeof(uint8_t));
+    g->item = calloc(cells, sizeof(uint8_t));
+    g->ready = calloc(words, sizeof(uint64_t));
+    g->ready_summary = calloc(summary, sizeof(uint64_t));
+    g->cell_stamp = calloc(cells, sizeof(uint32_t));
+    g->player_stamp = calloc(players, sizeof(uint32_t));
+    if (!g->hospital_until || !g->god_until || !g->bombs || !g->bankrupt || !g->occ_count
+        || !g->level || !g->item || !g->ready || !g->ready_summary || !g->cell_stamp
+        || !g->player_stamp) {
+        perror("calloc");
+        exit(1);
+    }
+    
+    init_map();
+    sim_board_from_map(&g->base);
+    for (int c = 0; c < cells; c++) {
+        g->owner[c] = -1;
+        g->occ_head[c] = -1;
+    }
+    
+    // 均匀分布出发时相邻座位在地图上相隔约 0.618 圈（步长与玩家数互质），
+    // 这样连续的一批回合落在地图的不同位置，很少相互影响
+    int stride = (int)(players * 0.618) | 1;
+    for (;;) {
+        int a = stride, b = players;
+        while (b) {
+            int r = a % b;
+            a = b;
+            b = r;
+        }
+        if (a == 1) break;
+        stride++;
+    }
+    
+    mass = g;
+    wheel_init(&g->wheel, g->wheel_next, g->wheel_prev, g->wheel_due, players, players, 0);
+    for (int p = 0; p < players; p++) {
+        g->money[p] = 10000;
+        g->points[p] = 500;
+        g->owned_head[p] = -1;
+        mass_occupy(g, p, spread ? (int)((long)p * stride % players * cells / players) : 0);
+        mass_mark_ready(p);
+    }
+    g->alive = players;
+    return per_player * players + per_cell * cells + sizeof(uint64_t) * (words + summary);
+}
+
+// 破产：交还所有地产，离开地图，不再参与调度
+void mass_bankrupt(MassGame *g, int p) {
+    if (g->bankrupt[p]) return;
+    g->bankrupt[p] = 1;
+    g->alive--;
+    g->bankruptcies++;
+    for (int c = g->owned_head[p]; c >= 0; c = g->owned_next[c]) {
+        g->owner[c] = -1;
+        g->level[c] = 0;
+        g->cell_stamp[c] = g->epoch;
+    }
+    g->owned_head[p] = -1;
+    mass_leave(g, p);
+    wheel_remove(&g->wheel, p);
+    mass_clear_ready(g, p);
+}
+
+// 切换到下一个能行动的玩家，没有玩家能行动时返回 0
+int mass_next_turn(MassGame *g) {
+    int n = g->players;
+    int base = g->turn_number;
+    wheel_expire(&g->wheel, base + n, mass_mark_ready);
+    for (;;) {
+        int seat = mass_ready_next(g, g->current + 1);
+        if (seat >= 0) {
+            g->turn_number = base + seat - g->current;
+            g->current = seat;
+            return 1;
+        }
+        seat = mass_ready_next(g, 0);
+        if (seat >= 0) {
+            g->turn_number = base + n - g->current + seat;
+            g->current = seat;
+            return 1;
+        }
+        if (g->wheel.occupied == 0) return 0;
+        base += n;
+        wheel_expire(&g->wheel, base + n, mass_mark_ready);
+    }
+}
+
+// 一个回合的推演结果：读到的状态和要写回的新值
+typedef struct {
+    int cp;
+    int turn;
+    int from, to;
+    int bomb_cell;        // 回合开始放炸弹的格子，-1 表示没有
+    int read_owner;       // 读过住院状态的地主，-1 表示没有
+    int payee;            // 收过路费的玩家，-1 表示没有
+    int fee;
+    int32_t money, points, hospital_until, god_until;
+    uint8_t bombs;
+    int32_t owner;        // 落点格子的新状态
+    uint8_t level, item;
+    uint8_t bought, hospitalised, bankrupt;
+} MassTurn;
+
+// 按快照推演 cp 在回合 turn 的行动，只读对局状态，规则与 sim_lanes_turn 相同
+void mass_plan(const MassGame *g, int cp, int turn, MassTurn *t) {
+    uint64_t x = g->seed + (uint64_t)turn;
+    rng_seed((uint32_t)splitmix64(&x));
+    int n = g->players;
+    
+    t->cp = cp;
+    t->turn = turn;
+    t->from = g->position[cp];
+    t->money = g->money[cp];
+    t->points = g->points[cp];
+    t->hospital_until = g->hospital_until[cp];
+    t->god_until = g->god_until[cp];
+    t->bombs = g->bombs[cp];
+    t->bomb_cell = t->read_owner = t->payee = -1;
+    t->fee = 0;
+    t->bought = t->hospitalised = t->bankrupt = 0;
+    
+    // 回合开始放置炸弹
+    if (t->bombs > 0) {
+        t->bombs--;
+        t->bomb_cell = (t->from + SIM_BOMB_DISTANCE) % g->cells;
+    }
+    
+    int pos = (t->from + rng_range(6) + 1) % g->cells;
+    t->to = pos;
+    t->owner = g->owner[pos];
+    t->level = g->level[pos];
+    t->item = pos == t->bomb_cell ? 3 : g->item[pos];
+    
+    int k = pos % TOTAL_CELLS;
+    int price = g->base.price[k];
+    int shop_skip = 0;
+    
+    switch (g->base.type[k]) {
+        case 'O': {
+            int owner = t->owner;
+            if (owner == -1 && t->money - price >= SIM_RESERVE) {
+                t->money -= price;
+                t->owner = cp;
+                t->bought = 1;
+            } else if (owner == cp && t->level < 3 && t->money - price >= SIM_RESERVE) {
+                t->money -= price;
+                t->level++;
+            } else if (owner >= 0 && owner != cp) {
+                t->read_owner = owner;
+                if (mass_god_left(g, turn, cp, t->god_until) == 0 && mass_hospital_left(g, turn, owner) == 0) {
+                    int fee = g->base.toll[k] * (t->level + 1);
+                    if (t->money < fee) {
+                        t->bankrupt = 1;
+                        return;
+                    }
+                    t->money -= fee;
+                    t->payee = owner;
+                    t->fee = fee;
+                }
+            }
+            break;
+        }
+        case 'T':
+            if (t->points >= 50 && t->bombs < MAX_ITEMS) {
+                t->points -= 50;
+                t->bombs++;
+            } else {
+                shop_skip = 1;
+            }
+            break;
+        case 'G':
+            switch (rng_range(3)) {
+                case 0: t->money += 2000; break;
+                case 1: t->points += 200; break;
+                case 2: t->god_until = turn + n + 4 * n; break;
+            }
+            break;
+        case 'M':
+            switch (rng_range(3)) {
+                case 0: t->money += 1000; break;
+                case 1: t->points += 100; break;
+                case 2: t->money -= 500; break;
+            }
+            break;
+        case '$':
+            t->points += 20 + rng_range(80);
+            break;
+    }
+    
+    // 触发格子上的道具：炸弹送进医院三回合
+    if (!shop_skip && t->item) {
+        if (t->item == 3) {
+            int god = mass_god_left(g, turn, cp, t->god_until);
+            t->hospital_until = turn + n + 3 * n;
+            if (god > 0) t->god_until = turn + n + (god + 2) * n;
+            t->hospitalised = 1;
+        }
+        t->item = 0;
+    }
+    
+    if (t->money < 0) t->bankrupt = 1;
+}
+
+// 推演时读过的格子或玩家是否已被本批中前面的回合改写
+int mass_conflicts(const MassGame *g, const MassTurn *t) {
+    uint32_t e = g->epoch;
+    return g->player_stamp[t->cp] == e || g->cell_stamp[t->to] == e
+        || (t->read_owner >= 0 && g->player_stamp[t->read_owner] == e);
+}
+
+// 把推演结果写回对局，并标记改写过的格子和玩家
+void mass_apply(MassGame *g, const MassTurn *t) {
+    int cp = t->cp;
+    int pos = t->to;
+    g->turns_played++;
+    
+    if (t->bomb_cell >= 0) {
+        g->item[t->bomb_cell] = 3;
+        g->cell_stamp[t->bomb_cell] = g->epoch;
+    }
+    mass_leave(g, cp);
+    mass_occupy(g, cp, pos);
+    
+    g->money[cp] = t->money;
+    g->points[cp] = t->points;
+    g->hospital_until[cp] = t->hospital_until;
+    g->god_until[cp] = t->god_until;
+    g->bombs[cp] = t->bombs;
+    g->player_stamp[cp] = g->epoch;
+    
+    // 只是路过的格子不算改写，免得同一格子上的后续回合被误判为冲突
+    if (g->owner[pos] != t->owner || g->level[pos] != t->level || g->item[pos] != t->item) {
+        g->owner[pos] = t->owner;
+        g->level[pos] = t->level;
+        g->item[pos] = t->item;
+        g->cell_stamp[pos] = g->epoch;
+    }
+    if (t->bought) {
+        g->owned_next[pos] = g->owned_head[cp];
+        g->owned_head[cp] = pos;
+    }
+    if (t->payee >= 0) {
+        g->money[t->payee] += t->fee;
+        g->player_stamp[t->payee] = g->epoch;
+    }
+    
+    if (t->hospitalised) {
+        mass_clear_ready(g, cp);
+        wheel_add(&g->wheel, cp, t->hospital_until);
+        g->hospital_stays++;
+    }
+    if (t->bankrupt) mass_bankrupt(g, cp);
+}
+
+// 当前玩家的一个回合
+void mass_turn(MassGame *g) {
+    MassTurn t;
+    mass_plan(g, g->current, g->turn_number, &t);
+    mass_apply(g, &t);
+}
+
+// 检查点保存玩家表和地图，占用、调度等结构在恢复时重建
+typedef struct {
+    int players;
+    int cells;
+    int turn_number;
+    int current;
+    int alive;
+    uint64_t seed;
+    long turns_played;
+    long bankruptcies;
+    long hospital_stays;
+    long replayed;
+} MassCheckpoint;
+
+int mass_save(int fd, void *arg) {
+    MassGame *g = arg;
+    MassCheckpoint c = {
+        g->players, g->cells, g->turn_number, g->current, g->alive, g->seed,
+        g->turns_played, g->bankruptcies, g->hospital_stays, g->replayed
+    };
+    size_t np = sizeof(int32_t) * g->players;
+    size_t nc = sizeof(int32_t) * g->cells;
+    if (checkpoint_write(fd, &c, sizeof(c)) < 0
+        || checkpoint_write(fd, g->money, np) < 0
+        || checkpoint_write(fd, g->points, np) < 0
+        || checkpoint_write(fd, g->position, np) < 0
+        || checkpoint_write(fd, g->hospital_until, np) < 0
+        || checkpoint_write(fd, g->god_until, np) < 0
+        || checkpoint_write(fd, g->bombs, g->players) < 0
+        || checkpoint_write(fd, g->bankrupt, g->players) < 0
+        || checkpoint_write(fd, g->owner, nc) < 0
+        || checkpoint_write(fd, g->level, g->cells) < 0
+        || checkpoint_write(fd, g->item, g->cells) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// 从检查点恢复对局，返回占用的字节数，失败时返回 0
+size_t mass_restore(MassGame *g, const char *path) {
+    MassCheckpoint c;
+    int fd = checkpoint_open(path, CHECKPOINT_MASS, sizeof(MassCheckpoint));
+    if (fd < 0 || checkpoint_read(fd, &c, sizeof(c)) != 1 || c.players < 2 || c.cells < TOTAL_CELLS) {
+        if (fd >= 0) close(fd);
+        return 0;
+    }
+    
+    size_t bytes = mass_init(g, c.players, c.cells, c.seed, 0);
+    size_t np = sizeof(int32_t) * c.players;
+    size_t nc = sizeof(int32_t) * c.cells;
+    int ok = checkpoint_read(fd, g->money, np) == 1
+             && checkpoint_read(fd, g->points, np) == 1
+             && checkpoint_read(fd, g->position, np) == 1
+             && checkpoint_read(fd, g->hospital_until, np) == 1
+             && checkpoint_read(fd, g->god_until, np) == 1
+             && checkpoint_read(fd, g->bombs, c.players) == 1
+             && checkpoint_read(fd, g->bankrupt, c.players) == 1
+             && checkpoint_read(fd, g->owner, nc) == 1
+             && checkpoint_read(fd, g->level, c.cells) == 1
+             && checkpoint_read(fd, g->item, c.cells) == 1;
+    close(fd);
+    if (!ok) {
+        mass_free(g);
+        return 0;
+    }
+    
+    g->turn_number = c.turn_number;
+    g->current = c.current;
+    g->alive = c.alive;
+    g->turns_played = c.turns_played;
+    g->bankruptcies = c.bankruptcies;
+    g->hospital_stays = c.hospital_stays;
+    g->replayed = c.replayed;
+    
+    for (int i = 0; i < c.cells; i++) {
+        g->occ_head[i] = -1;
+        g->occ_count[i] = 0;
+    }
+    memset(g->ready, 0, sizeof(uint64_t) * ((c.players + 63) >> 6));
+    memset(g->ready_summary, 0, sizeof(uint64_t) * ((c.players + 4095) >> 12));
+    wheel_init(&g->wheel, g->wheel_next, g->wheel_prev, g->wheel_due, c.players, c.players, c.turn_number);
+    for (int p = 0; p < c.players; p++) {
+        g->owned_head[p] = -1;
+        if (g->bankrupt[p]) continue;
+        mass_occupy(g, p, g->position[p]);
+        if (g->hospital_until[p] > c.turn_number) {
+            wheel_add(&g->wheel, p, g->hospital_until[p]);
+        } else {
+            mass_mark_ready(p);
+        }
+    }
+    for (int i = c.cells - 1; i >= 0; i--) {
+        if (g->owner[i] < 0) continue;
+        g->owned_next[i] = g->owned_head[g->owner[i]];
+        g->owned_head[g->owner[i]] = i;
+    }
+    return bytes;
+}
+
+// 到了检查点间隔就 fork 出子进程写检查点
+void mass_checkpoint(MassGame *g) {
+    if (g->next_checkpoint == 0) return;
+    double now = now_ms();
+    if (now < g->next_checkpoint) return;
+    checkpoint_fork(CHECKPOINT_MASS, sizeof(MassCheckpoint), mass_save, g);
+    g->next_checkpoint = now + checkpoint_ms;
+}
+
+// 顺序执行到只剩一人或达到回合上限
+void mass_run(MassGame *g, long limit) {
+    mass = g;
+    while (g->alive > 1 && g->turn_number < limit) {
+        mass_turn(g);
+        if (!mass_next_turn(g)) break;
+        if ((g->turns_played & 4095) == 0) mass_checkpoint(g);
+    }
+}
+
+// 从当前玩家起，本轮内接下来最多 max 个能行动的回合。
+// 本批的回合只会改变自己的住院和破产状态，而各自在本批中只出现一次，所以这个顺序不会变。
+int mass_window(MassGame *g, MassTurn *turns, int max) {
+    int n = g->players;
+    int cur = g->current;
+    int t0 = g->turn_number;
+    wheel_expire(&g->wheel, t0 + n, mass_mark_ready);
+    
+    int count = 0;
+    turns[count].cp = cur;
+    turns[count++].turn = t0;
+    for (int s = mass_ready_next(g, cur + 1); s >= 0 && count < max; s = mass_ready_next(g, s + 1)) {
+        turns[count].cp = s;
+        turns[count++].turn = t0 + s - cur;
+    }
+    for (int s = mass_ready_next(g, 0); s >= 0 && s < cur && count < max; s = mass_ready_next(g, s + 1)) {
+        turns[count].cp = s;
+        turns[count++].turn = t0 + n - cur + s;
+    }
+    return count;
+}
+
+// 按顺序提交一批推演结果，冲突的回合按当前状态重新执行。
+// 游戏在本批中途结束时返回 0
+int mass_commit(MassGame *g, MassTurn *turns, int count, long limit) {
+    g->epoch++;
+    for (int i = 0; i < count; i++) {
+        MassTurn *t = &turns[i];
+        g->turn_number = t->turn;
+        g->current = t->cp;
+        if (g->alive <= 1 || t->turn >= limit) return 0;
+        if (mass_conflicts(g, t)) {
+            mass_plan(g, t->cp, t->turn, t);
+            g->replayed++;
+        }
+        mass_apply(g, t);
+    }
+    return mass_next_turn(g);
+}
+
+typedef struct {
+    MassGame *g;
+    MassTurn *turns;
+    int count;
+    int threads;
+    int stop;
+    pthread_barrier_t start;
+    pthread_barrier_t done;
+} MassPool;
+
+typedef struct {
+    MassPool *pool;
+    int id;
+} MassWorker;
+
+void mass_plan_share(MassPool *pool, int id) {
+    int lo = (int)((long)pool->count * id / pool->threads);
+    int hi = (int)((long)pool->count * (id + 1) / pool->threads);
+    for (int i = lo; i < hi; i++) {
+        mass_plan(pool->g, pool->turns[i].cp, pool->turns[i].turn, &pool->turns[i]);
+    }
+}
+
+void *mass_worker(void *arg) {
+    MassWorker *w = arg;
+    MassPool *pool = w->pool;
+    for (;;) {
+        pthread_barrier_wait(&pool->start);
+        if (pool->stop) break;
+        mass_plan_share(pool, w->id);
+        pthread_barrier_wait(&pool->done);
+    }
+    return NULL;
+}
+
+// 推测执行：每批最多 window 个回合在所有线程上并行推演，再由主线程按顺序提交
+void mass_run_speculative(MassGame *g, long limit, int window) {
+    int threads = bot_threads > 0 ? bot_threads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) threads = 1;
+    if (threads > MAX_SEARCH_THREADS) threads = MAX_SEARCH_THREADS;
+    if (window > g->players) window = g->players;
+    
+    MassPool pool = { .g = g, .turns = xmalloc(sizeof(MassTurn) * window), .threads = threads };
+    MassWorker workers[MAX_SEARCH_THREADS];
+    pthread_t tids[MAX_SEARCH_THREADS];
+    pthread_barrier_init(&pool.start, NULL, threads);
+    pthread_barrier_init(&pool.done, NULL, threads);
+    for (int t = 1; t < threads; t++) {
+        workers[t].pool = &pool;
+        workers[t].id = t;
+        if (pthread_create(&tids[t], NULL, mass_worker, &workers[t]) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+    
+    mass = g;
+    while (g->alive > 1 && g->turn_number < limit) {
+        pool.count = mass_window(g, pool.turns, window);
+        pthread_barrier_wait(&pool.start);
+        mass_plan_share(&pool, 0);
+        pthread_barrier_wait(&pool.done);
+        if (!mass_commit(g, pool.turns, pool.count, limit)) break;
+        mass_checkpoint(g);
+    }
+    
+    pool.stop = 1;
+    pthread_barrier_wait(&pool.start);
+    for (int t = 1; t < threads; t++) {
+        pthread_join(tids[t], NULL);
+    }
+    pthread_barrier_destroy(&pool.start);
+    pthread_barrier_destroy(&pool.done);
+    free(pool.turns);
+}
+
+uint64_t mass_mix(uint64_t h, uint32_t v) {
+    return (h ^ v) * 1099511628211ull;
+}
+
+// 玩家和地图状态的摘要，用于比较两种执行方式的结果
+uint64_t mass_checksum(const MassGame *g) {
+    uint64_t h = 1469598103934665603ull;
+    for (int p = 0; p < g->players; p++) {
+        h = mass_mix(h, g->money[p]);
+        h = mass_mix(h, g->points[p]);
+        h = mass_mix(h, g->position[p]);
+        h = mass_mix(h, g->hospital_until[p]);
+        h = mass_mix(h, g->god_until[p]);
+        h = mass_mix(h, g->bombs[p] | g->bankrupt[p] << 8);
+    }
+    for (int c = 0; c < g->cells; c++) {
+        h = mass_mix(h, g->owner[c]);
+        h = mass_mix(h, g->level[c] | g->item[c] << 8);
+    }
+    h = mass_mix(h, g->turn_number);
+    h = mass_mix(h, g->alive);
+    return h;
+}
+
+// 显示 from 开始的 count 个格子上的人数
+void mass_show_window(MassGame *g, int from, int count) {
+    printf("格子 %d-%d 上的玩家数:\n", from, from + count - 1);
+    for (int i = 0; i < count; i++) {
+        int c = (from + i) % g->cells;
+        int n = g->occ_count[c];
+        char mark = n == 0 ? (char)g->base.type[c % TOTAL_CELLS] : (n < 10 ? '0' + n : '+');
+        putchar(mark);
+    }
+    putchar('\n');
+}
+
+// window > 0 时使用推测执行，并用相同种子顺序执行一遍核对结果。
+// resume 不为空时从检查点继续，玩家数、格子数和种子取自检查点
+void mass_main(int players, int cells, int rounds, int spread, int window, const char *resume) {
+    if (players < 2) players = 2;
+    if (cells <= 0) cells = players * (TOTAL_CELLS / MAX_PLAYERS);
+    cells = (cells + TOTAL_CELLS - 1) / TOTAL_CELLS * TOTAL_CELLS;   // 整数个标准地图
+    if (rounds <= 0) rounds = MASS_ROUNDS;
+    
+    uint64_t seed = (uint64_t)time(NULL);
+    MassGame *g = xmalloc(sizeof(MassGame));
+    size_t bytes;
+    if (resume) {
+        bytes = mass_restore(g, resume);
+        if (bytes == 0) {
+            fprintf(stderr, "无法从检查点 %s 恢复\n", resume);
+            free(g);
+            return;
+        }
+        players = g->players;
+        cells = g->cells;
+        seed = g->seed;
+        printf("从检查点 %s 恢复: 回合序号 %d, 剩余 %d 人\n", resume, g->turn_number, g->alive);
+    } else {
+        bytes = mass_init(g, players, cells, seed, spread);
+    }
+    long limit = (long)players * rounds;
+    if (limit > INT32_MAX / 2) limit = INT32_MAX / 2;
+    printf("大规模模式: %d 名玩家, %d 个格子, %d 轮, 状态 %.1f MB\n",
+           players, cells, rounds, bytes / 1048576.0);
+    if (checkpoint_path) g->next_checkpoint = now_ms() + checkpoint_ms;
+    
+    // 第 0 号玩家先行动
+    long played_before = g->turns_played;
+    double start = now_ms();
+    if (window > 0) {
+        mass_run_speculative(g, limit, window);
+    } else {
+        mass_run(g, limit);
+    }
+    double elapsed = (now_ms() - start) / 1000.0;
+    
+    int richest = -1;
+    for (int p = 0; p < players; p++) {
+        if (!g->bankrupt[p] && (richest < 0 || g->money[p] > g->money[richest])) richest = p;
+    }
+    int crowded = 0;
+    for (int c = 0; c < cells; c++) {
+        if (g->occ_count[c] > g->occ_count[crowded]) crowded = c;
+    }
+    
+    printf("回合序号 %d, 实际行动 %ld 回合, 用时 %.2f 秒 (%.0f 回合/秒)\n",
+           g->turn_number, g->turns_played, elapsed, (g->turns_played - played_before) / elapsed);
+    printf("破产 %ld 人, 剩余 %d 人, 住院 %ld 次\n", g->bankruptcies, g->alive, g->hospital_stays);
+    if (richest >= 0) {
+        printf("最富有: 玩家 %d, 资金 %d元, 点数 %d, 位置 %d\n",
+               richest, g->money[richest], g->points[richest], g->position[richest]);
+        mass_show_window(g, g->position[richest] >= 30 ? g->position[richest] - 30 : 0, 60);
+    }
+    printf("最拥挤的格子: %d (%d 人)\n", crowded, g->occ_count[crowded]);
+    printf("状态摘要: %016llx\n", (unsigned long long)mass_checksum(g));
+    checkpoint_reap(1);
+    checkpoint_report(stdout);
+    
+    if (window > 0 && !resume) {
+        printf("推测执行: 每批 %d 回合, 重新执行 %ld 回合 (%.1f%%)\n",
+               window, g->replayed, 100.0 * g->replayed / g->turns_played);
+        MassGame *check = xmalloc(sizeof(MassGame));
+        mass_init(check, players, cells, seed, spread);
+        start = now_ms();
+        mass_run(check, limit);
+        double sequential = (now_ms() - start) / 1000.0;
+        int same = mass_checksum(g) == mass_checksum(check);
+        printf("顺序执行用时 %.2f 秒, 加速 %.2fx, 结果%s\n",
+               sequential, sequential / elapsed, same ? "一致" : "不一致");
+        mass_free(check);
+        free(check);
+    }
+    
+    mass_free(g);
+    free(g);
+}
+
+// ===================== 多会话游戏服务器 =====================
+// 在 Unix 域套接字上接受连接，每个连接是一局独立的游戏（热座模式，电脑玩家使用
+// greedy_policy 以免阻塞）。会话是由输入行驱动的状态机，游戏状态保存在会话中，
+// 处理时载入工作线程的线程局部状态。所有工作线程共用一个 epoll，
+// 客户端用 EPOLLONESHOT 注册，保证同一会话同一时刻只由一个线程处理。
+
+#define SESSION_LINE_MAX 256
+#define SERVER_EVENTS 64
+
+typedef enum {
+    PHASE_PLAYERS,   // 等待玩家数量
+    PHASE_MONEY,     // 等待初始资金
+    PHASE_COMMAND,   // 等待回合命令
+    PHASE_DECISION,  // 等待购买/升级/道具屋的回答
+    PHASE_CLOSING,   // 发送完剩余输出后关闭
+    PHASE_WATCH      // 旁观者，移交给旁观线程
+} SessionPhase;
+
+typedef struct Channel Channel;
+
+typedef struct {
+    int fd;
+    int id;
+    SessionPhase phase;
+    Channel *channel; // 本局的旁观频道
+    int watch_id;     // 旁观者要观看的对局
+    int pending;      // 等待回答的决策类型
+    GameState game;
+    uint32_t rng;
+    char in[SESSION_LINE_MAX];
+    size_t in_len;
+    OutBuf out;
+    size_t out_sent;
+    OutBuf wire;      // io_uring 后端：正在发送的数据，发送期间 out 可继续追加
+    int sending;      // io_uring 后端：有未完成的发送
+    int receiving;    // io_uring 后端：多次接收请求仍然有效
+    int dead;         // io_uring 后端：连接已断开，等待请求全部完成后释放
+    int cancelling;   // io_uring 后端：已请求取消多次 recv
+} Session;
+
+int server_fd = -1;
+int server_epoll = -1;
+int server_threads = 0;     // 0 表示使用全部CPU
+int server_uring = 0;       // 使用 io_uring 后端
+_Atomic int next_session_id = 1;
+_Atomic int live_sessions;
+
+// ----- 旁观 -----
+// 对局状态变化时只渲染一次画面，存入带引用计数的 Frame，所有旁观者共享同一份数据。
+// 旁观连接由单独的旁观线程负责（边沿触发的 epoll），每个旁观者有一个帧队列，
+// 用 sendmsg 一次把队列中所有帧的 iovec 写出；队列满时用最新的帧替换队尾，
+// 跟不上的旁观者只会跳帧，不会拖慢对局。Unix 域套接字不支持 MSG_ZEROCOPY，
+// 所以每个旁观者只剩内核把数据拷进套接字缓冲区这一次拷贝。
+
+#include <sys/uio.h>
+
+#define SPECTATOR_QUEUE 8
+#define CHANNEL_BUCKETS 1024
+
+typedef struct {
+    _Atomic int refs;
+    size_t len;
+    char data[];
+} Frame;
+
+typedef struct Spectator {
+    int fd;
+    pthread_mutex_t lock;
+    Frame *queue[SPECTATOR_QUEUE];
+    int head;
+    int count;
+    size_t offset;            // 队首帧已发送的字节数
+    int finished;             // 对局已结束，发完后关闭
+    Channel *channel;
+    struct Spectator *next;
+} Spectator;
+
+struct Channel {
+    int id;
+    pthread_mutex_t lock;     // 保护 viewers 和 latest
+    Spectator *viewers;
+    _Atomic int viewer_count;
+    _Atomic int refs;         // 对局会话和每个旁观者各持有一个引用
+    int closed;
+    Frame *latest;            // 最近一次渲染的画面
+    uint64_t latest_hash;
+    _Atomic uint64_t hash;    // 对局当前的状态哈希
+    GameState saved;          // 检查点：最近一次停在命令提示处的状态
+    uint32_t saved_rng;
+    int resumable;            // saved 有效且对局未结束
+    Channel *next;
+};
+
+Channel *channel_table[CHANNEL_BUCKETS];
+pthread_mutex_t channel_table_lock = PTHREAD_MUTEX_INITIALIZER;
+int spectator_epoll = -1;
+pthread_once_t spectator_once = PTHREAD_ONCE_INIT;
+
+void frame_release(Frame *f) {
+    if (f && atomic_fetch_sub(&f->refs, 1) == 1) free(f);
+}
+
+Frame *frame_new(const char *data, size_t len) {
+    Frame *f = xmalloc(sizeof(Frame) + len);
+    atomic_init(&f->refs, 1);
+    f->len = len;
+    memcpy(f->data, data, len);
+    return f;
+}
+
+Channel *channel_new(int id) {
+    Channel *ch = calloc(1, sizeof(Channel));
+    if (ch == NULL) return NULL;
+    ch->id = id;
+    pthread_mutex_init(&ch->lock, NULL);
+    atomic_init(&ch->refs, 1);
+    
+    pthread_mutex_lock(&channel_table_lock);
+    ch->next = channel_table[id % CHANNEL_BUCKETS];
+    channel_table[id % CHANNEL_BUCKETS] = ch;
+    pthread_mutex_unlock(&channel_table_lock);
+    return ch;
+}
+
+void channel_release(Channel *ch) {
+    if (atomic_fetch_sub(&ch->refs, 1) != 1) return;
+    frame_release(ch->latest);
+    pthread_mutex_destroy(&ch->lock);
+    free(ch);
+}
+
+// 按对局编号查找频道，找到时增加一个引用
+Channel *channel_find(int id) {
+    pthread_mutex_lock(&channel_table_lock);
+    Channel *ch = channel_table[id % CHANNEL_BUCKETS];
+    while (ch && ch->id != id) ch = ch->next;
+    if (ch) atomic_fetch_add(&ch->refs, 1);
+    pthread_mutex_unlock(&channel_table_lock);
+    return ch;
+}
+
+// 尽量发出队列中的帧（调用者持有 v->lock）
+void spectator_flush(Spectator *v) {
+    while (v->count > 0) {
+        struct iovec iov[SPECTATOR_QUEUE];
+        for (int i = 0; i < v->count; i++) {
+            Frame *f = v->queue[(v->head + i) % SPECTATOR_QUEUE];
+            size_t skip = i == 0 ? v->offset : 0;
+            iov[i].iov_base = f->data + skip;
+            iov[i].iov_len = f->len - skip;
+        }
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = v->count;
+        ssize_t sent = sendmsg(v->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return;   // 缓冲区满时等待 EPOLLOUT，出错时等待旁观线程收到挂断事件
+        }
+        while (v->count > 0) {
+            Frame *f = v->queue[v->head];
+            size_t left = f->len - v->offset;
+            if ((size_t)sent < left) {
+                v->offset += sent;
+                break;
+            }
+            sent -= left;
+            frame_release(f);
+            v->head = (v->head + 1) % SPECTATOR_QUEUE;
+            v->count--;
+            v->offset = 0;
+        }
+    }
+    if (v->finished) shutdown(v->fd, SHUT_RDWR);
+}
+
+// 把一帧加入旁观者的队列并尝试发送（调用者持有 v->lock）
+void spectator_push(Spectator *v, Frame *f) {
+    atomic_fetch_add(&f->refs, 1);
+    if (v->count == SPECTATOR_QUEUE) {
+        int tail = (v->head + v->count - 1) % SPECTATOR_QUEUE;
+        frame_release(v->queue[tail]);
+        v->queue[tail] = f;
+    } else {
+        v->queue[(v->head + v->count) % SPECTATOR_QUEUE] = f;
+        v->count++;
+    }
+    spectator_flush(v);
+}
+
+// 对局状态变化后渲染一帧并分发给所有旁观者（当前线程已载入该会话的游戏状态）
+void session_publish(Session *s) {
+    Channel *ch = s->channel;
+    if (ch == NULL || s->phase < PHASE_COMMAND || s->phase > PHASE_CLOSING) return;
+    atomic_store_explicit(&ch->hash, state_hash, memory_order_relaxed);
+    if (atomic_load_explicit(&ch->viewer_count, memory_order_relaxed) == 0) return;
+    if (ch->latest && ch->latest_hash == state_hash) return;
+    
+    static __thread OutBuf scratch;
+    OutBuf *saved = game_out;
+    scratch.len = 0;
+    game_out = &scratch;
+    game_printf("\033[H\033[2J第 %d 局  轮到 %s\n", s->id, players[current_player].name);
+    display_map();
+    for (int i = 0; i < player_count; i++) {
+        display_player_status(i);
+    }
+    if (game_over) game_printf("游戏结束!\n");
+    game_out = saved;
+    Frame *f = frame_new(scratch.data, scratch.len);
+    
+    pthread_mutex_lock(&ch->lock);
+    frame_release(ch->latest);
+    ch->latest = f;
+    ch->latest_hash = state_hash;
+    for (Spectator *v = ch->viewers; v; v = v->next) {
+        pthread_mutex_lock(&v->lock);
+        spectator_push(v, f);
+        pthread_mutex_unlock(&v->lock);
+    }
+    pthread_mutex_unlock(&ch->lock);
+}
+
+// 对局结束：从表中移除频道，旁观者发完剩余的帧后断开
+void channel_close(Channel *ch) {
+    pthread_mutex_lock(&channel_table_lock);
+    Channel **link = &channel_table[ch->id % CHANNEL_BUCKETS];
+    while (*link != ch) link = &(*link)->next;
+    *link = ch->next;
+    pthread_mutex_unlock(&channel_table_lock);
+    
+    pthread_mutex_lock(&ch->lock);
+    ch->closed = 1;
+    for (Spectator *v = ch->viewers; v; v = v->next) {
+        pthread_mutex_lock(&v->lock);
+        v->finished = 1;
+        spectator_flush(v);
+        pthread_mutex_unlock(&v->lock);
+    }
+    pthread_mutex_unlock(&ch->lock);
+    channel_release(ch);
+}
+
+// 旁观者断开：先从频道中移除，之后对局线程不会再访问它
+void spectator_free(Spectator *v) {
+    Channel *ch = v->channel;
+    pthread_mutex_lock(&ch->lock);
+    Spectator **link = &ch->viewers;
+    while (*link != v) link = &(*link)->next;
+    *link = v->next;
+    atomic_fetch_sub(&ch->viewer_count, 1);
+    pthread_mutex_unlock(&ch->lock);
+    
+    while (v->count > 0) {
+        frame_release(v->queue[v->head]);
+        v->head = (v->head + 1) % SPECTATOR_QUEUE;
+        v->count--;
+    }
+    close(v->fd);
+    pthread_mutex_destroy(&v->lock);
+    free(v);
+    channel_release(ch);
+}
+
+void *spectator_worker(void *arg) {
+    (void)arg;
+    struct epoll_event events[SERVER_EVENTS];
+    char buf[1024];
+    
+    for (;;) {
+        int n = epoll_wait(spectator_epoll, events, SERVER_EVENTS, -1);
+        for (int i = 0; i < n; i++) {
+            Spectator *v = events[i].data.ptr;
+            int alive = 1;
+            if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                // 旁观者的输入全部丢弃，只关心连接是否断开
+                for (;;) {
+                    ssize_t len = recv(v->fd, buf, sizeof(buf), MSG_DONTWAIT);
+                    if (len > 0) continue;
+                    if (len < 0 && errno == EINTR) continue;
+                    if (len == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) alive = 0;
+                    break;
+                }
+            }
+            if (!alive) {
+                spectator_free(v);
+                continue;
+            }
+            if (events[i].events & EPOLLOUT) {
+                pthread_mutex_lock(&v->lock);
+                spectator_flush(v);
+                pthread_mutex_unlock(&v->lock);
+            }
+        }
+    }
+    return NULL;
+}
+
+void spectator_start() {
+    spectator_epoll = epoll_create1(EPOLL_CLOEXEC);
+    pthread_t tid;
+    pthread_create(&tid, NULL, spectator_worker, NULL);
+    pthread_detach(tid);
+}
+
+void session_free(Session *s) {
+    if (s->fd >= 0) close(s->fd);
+    if (s->channel) channel_close(s->channel);
+    free(s->out.data);
+    free(s->wire.data);
+    free(s);
+    atomic_fetch_sub(&live_sessions, 1);
+}
+
+// 把旁观者的连接从会话移交给旁观线程
+void spectator_attach(Session *s) {
+    int fd = s->fd;
+    int watch_id = s->watch_id;
+    s->fd = -1;
+    session_free(s);
+    
+    char intro[128];
+    Channel *ch = channel_find(watch_id);
+    if (ch == NULL) {
+        int len = snprintf(intro, sizeof(intro), "没有第 %d 局\n", watch_id);
+        send(fd, intro, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+        close(fd);
+        return;
+    }
+    
+    pthread_once(&spectator_once, spectator_start);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    Spectator *v = xmalloc(sizeof(Spectator));
+    memset(v, 0, sizeof(Spectator));
+    v->fd = fd;
+    v->channel = ch;
+    pthread_mutex_init(&v->lock, NULL);
+    
+    int len = snprintf(intro, sizeof(intro), "正在旁观第 %d 局\n", ch->id);
+    Frame *f = frame_new(intro, len);
+    pthread_mutex_lock(&ch->lock);
+    pthread_mutex_lock(&v->lock);
+    spectator_push(v, f);
+    // 最近一帧仍是当前状态时直接发给新的旁观者，否则等下一次状态变化
+    if (ch->latest && ch->latest_hash == atomic_load(&ch->hash)) spectator_push(v, ch->latest);
+    v->finished = ch->closed;
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.ptr = v;
+    epoll_ctl(spectator_epoll, EPOLL_CTL_ADD, fd, &ev);
+    pthread_mutex_unlock(&v->lock);
+    v->next = ch->viewers;
+    ch->viewers = v;
+    atomic_fetch_add(&ch->viewer_count, 1);
+    pthread_mutex_unlock(&ch->lock);
+    frame_release(f);
+}
+
+// ----- 检查点 -----
+// 开启 --checkpoint 时，会话每次停在命令提示处就把状态复制到频道里。
+// 检查点线程按间隔 fork，子进程遍历频道表写出所有未结束的对局。
+// 服务器重启后从检查点载入这些对局，客户端第一行输入 `resume 编号` 即可接着玩。
+
+typedef struct {
+    int id;
+    uint32_t rng;
+    GameState state;
+} SavedGame;
+
+// 复制状态的会话线程之间互不影响，所以取读锁；fork 时取写锁，保证子进程看到完整的副本
+pthread_rwlock_t checkpoint_lock = PTHREAD_RWLOCK_INITIALIZER;
+SavedGame *restore_games;     // 从检查点载入、还没有被恢复的对局
+int restore_count;
+pthread_mutex_t restore_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void session_checkpoint(Session *s) {
+    Channel *ch = s->channel;
+    if (ch == NULL) return;
+    pthread_rwlock_rdlock(&checkpoint_lock);
+    if (s->phase == PHASE_COMMAND) {
+        ch->saved = s->game;
+        ch->saved_rng = s->rng;
+        ch->resumable = 1;
+    } else if (s->phase == PHASE_CLOSING) {
+        ch->resumable = 0;
+    }
+    pthread_rwlock_unlock(&checkpoint_lock);
+}
+
+// 在子进程中运行：写出所有未结束的对局
+int server_checkpoint_save(int fd, void *arg) {
+    (void)arg;
+    for (int b = 0; b < CHANNEL_BUCKETS; b++) {
+        for (Channel *ch = channel_table[b]; ch; ch = ch->next) {
+            if (!ch->resumable) continue;
+            SavedGame g = { ch->id, ch->saved_rng, ch->saved };
+            if (checkpoint_write(fd, &g, sizeof(g)) < 0) return -1;
+        }
+    }
+    for (int i = 0; i < restore_count; i++) {
+        if (checkpoint_write(fd, &restore_games[i], sizeof(SavedGame)) < 0) return -1;
+    }
+    return 0;
+}
+
+void *checkpoint_worker(void *arg) {
+    (void)arg;
+    for (;;) {
+        usleep(checkpoint_ms * 1000);
+        pthread_rwlock_wrlock(&checkpoint_lock);
+        pthread_mutex_lock(&channel_table_lock);
+        pthread_mutex_lock(&restore_lock);
+        checkpoint_fork(CHECKPOINT_SERVER, sizeof(SavedGame), server_checkpoint_save, NULL);
+        pthread_mutex_unlock(&restore_lock);
+        pthread_mutex_unlock(&channel_table_lock);
+        pthread_rwlock_unlock(&checkpoint_lock);
+        if (checkpoint_taken % 60 == 1) checkpoint_report(stderr);
+    }
+    return NULL;
+}
+
+// 启动时载入上一次的检查点，新对局的编号接在其中最大的编号之后
+void server_restore_load() {
+    int fd = checkpoint_open(checkpoint_path, CHECKPOINT_SERVER, sizeof(SavedGame));
+    if (fd < 0) return;
+    SavedGame g;
+    int cap = 0;
+    while (checkpoint_read(fd, &g, sizeof(g)) == 1) {
+        if (restore_count == cap) {
+            cap = cap ? cap * 2 : 64;
+            restore_games = realloc(restore_games, sizeof(SavedGame) * cap);
+            if (restore_games == NULL) {
+                perror("realloc");
+                exit(1);
+            }
+        }
+        restore_games[restore_count++] = g;
+        if (g.id >= atomic_load(&next_session_id)) atomic_store(&next_session_id, g.id + 1);
+    }
+    close(fd);
+    fprintf(stderr, "从检查点 %s 载入 %d 局\n", checkpoint_path, restore_count);
+}
+
+// 把检查点中的第 id 局载入当前线程，找不到时返回 0
+int session_resume(int id) {
+    SavedGame g;
+    int found = 0;
+    pthread_mutex_lock(&restore_lock);
+    for (int i = 0; i < restore_count; i++) {
+        if (restore_games[i].id == id) {
+            g = restore_games[i];
+            restore_games[i] = restore_games[--restore_count];
+            found = 1;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&restore_lock);
+    if (!found) return 0;
+    load_state(&g.state);
+    rng_state = g.rng;
+    return 1;
+}
+
+// 推进到下一个需要人类玩家输入的回合，途中完成电脑玩家的回合
+void session_next_turn(Session *s) {
+    while (!game_over) {
+        Player *current = &players[current_player];
+        game_printf("\n轮到 %s 的回合\n", current->name);
+        display_player_status(current_player);
+        
+        if (current->is_bot) {
+            apply_item_action(current_player, decide(DECIDE_ITEM, current_player));
+            roll_and_move(current_player);
+            display_map();
+            end_turn();
+            continue;
+        }
+        
+        display_map();
+        game_printf("\n请输入命令 (输入help查看帮助): ");
+        s->phase = PHASE_COMMAND;
+        return;
+    }
+    game_printf("游戏结束!\n");
+    s->phase = PHASE_CLOSING;
+}
+
+// 回合命令或决策回答之后：等待决策，或结束回合
+void session_after_move(Session *s) {
+    if (pending_decision >= 0) {
+        s->pending = pending_decision;
+        pending_decision = -1;
+        s->phase = PHASE_DECISION;
+        return;
+    }
+    end_turn();
+    session_next_turn(s);
+}
+
+// 处理一行输入（当前线程已载入该会话的游戏状态）
+void session_input(Session *s, char *line) {
+    switch (s->phase) {
+        case PHASE_PLAYERS: {
+            if (strncasecmp(line, "watch", 5) == 0) {
+                s->watch_id = atoi(line + 5);
+                s->phase = PHASE_WATCH;
+                break;
+            }
+            if (strncasecmp(line, "resume", 6) == 0) {
+                int id = atoi(line + 6);
+                if (session_resume(id)) {
+                    game_printf("已恢复第 %d 局\n", id);
+                    session_next_turn(s);
+                } else {
+                    game_printf("检查点中没有第 %d 局\n请输入玩家数量 (2-4): ", id);
+                }
+                break;
+            }
+            int count = atoi(line);
+            if (count < 2 || count > 4) {
+                game_printf("玩家数量必须在2-4之间，已设置为2\n");
+                count = 2;
+            }
+            player_count = count;
+            game_printf("请输入初始资金 (默认10000): ");
+            s->phase = PHASE_MONEY;
+            break;
+        }
+        case PHASE_MONEY: {
+            int initial_money = atoi(line);
+            if (initial_money < 1000 || initial_money > 50000) {
+                game_printf("初始资金必须在1000-50000之间，已设置为10000\n");
+                initial_money = 10000;
+            }
+            init_map();
+            init_players(player_count, initial_money);
+            int bots = bot_count < player_count ? bot_count : player_count;
+            for (int i = player_count - bots; i < player_count; i++) {
+                players[i].is_bot = 1;
+            }
+            game_printf("游戏开始! 初始资金: %d元\n", initial_money);
+            session_next_turn(s);
+            break;
+        }
+        case PHASE_COMMAND: {
+            char command[20];
+            int arg = 0;
+            if (sscanf(line, "%19s %d", command, &arg) < 1) {
+                game_printf("\n请输入命令 (输入help查看帮助): ");
+                break;
+            }
+            int result = exec_command(command, arg);
+            if (result == CMD_QUIT) {
+                game_over = 1;
+                game_printf("游戏结束!\n");
+                s->phase = PHASE_CLOSING;
+            } else if (result == CMD_MOVED) {
+                session_after_move(s);
+            } else {
+                display_map();
+                game_printf("\n请输入命令 (输入help查看帮助): ");
+            }
+            break;
+        }
+        case PHASE_DECISION: {
+            int action;
+            if (s->pending == DECIDE_SHOP) {
+                action = atoi(line);
+            } else {
+                char c = ' ';
+                sscanf(line, " %c", &c);
+                action = tolower(c) == 'y';
+            }
+            resume_turn(s->pending, action);
+            session_next_turn(s);
+            break;
+        }
+        case PHASE_CLOSING:
+        case PHASE_WATCH:
+            break;
+    }
+}
+
+// 在当前线程上载入会话，处理若干行后保存
+void session_begin(Session *s) {
+    load_state(&s->game);
+    rng_state = s->rng;
+    game_out = &s->out;
+}
+
+void session_end(Session *s) {
+    session_publish(s);
+    save_state(&s->game);
+    s->rng = rng_state;
+    game_out = NULL;
+    if (checkpoint_path) session_checkpoint(s);
+}
+
+// 尽量发送缓冲区中的输出，返回 -1 表示连接已断开
+int session_flush(Session *s) {
+    while (s->out_sent < s->out.len) {
+        ssize_t n = send(s->fd, s->out.data + s->out_sent, s->out.len - s->out_sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        s->out_sent += n;
+    }
+    s->out.len = s->out_sent = 0;
+    return 0;
+}
+
+// 把收到的数据切分成行并逐行处理（需已调用 session_begin）
+void session_feed(Session *s, const char *buf, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        char c = buf[i];
+        if (c == '\n') {
+            s->in[s->in_len] = '\0';
+            if (s->in_len > 0 && s->in[s->in_len - 1] == '\r') s->in[s->in_len - 1] = '\0';
+            session_input(s, s->in);
+            s->in_len = 0;
+        } else if (s->in_len < SESSION_LINE_MAX - 1) {
+            s->in[s->in_len++] = c;
+        }
+    }
+}
+
+// 读取所有可读数据并逐行处理，返回 -1 表示对方已关闭
+int session_read(Session *s) {
+    char buf[4096];
+    int alive = 1;
+    
+    session_begin(s);
+    while (alive) {
+        ssize_t n = recv(s->fd, buf, sizeof(buf), 0);
+        if (n == 0) {
+            alive = 0;
+            break;
+        }
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) alive = 0;
+            break;
+        }
+        session_feed(s, buf, n);
+    }
+    session_end(s);
+    return alive ? 0 : -1;
+}
+
+// 重新注册会话的事件（EPOLLONESHOT），有未发完的输出时同时等待可写
+void session_arm(Session *s, int op) {
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+    if (s->out_sent < s->out.len) ev.events |= EPOLLOUT;
+    ev.data.ptr = s;
+    if (epoll_ctl(server_epoll, op, s->fd, &ev) == -1) {
+        perror("epoll_ctl");
+        session_free(s);
+    }
+}
+
+void session_event(Session *s, uint32_t events) {
+    int alive = 1;
+    if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+        alive = session_read(s) == 0;
+    }
+    if (session_flush(s) < 0) alive = 0;
+    if (s->phase == PHASE_CLOSING && s->out.len == 0) alive = 0;
+    if (alive && s->phase == PHASE_WATCH) {
+        spectator_attach(s);
+        return;
+    }
+    
+    if (!alive) {
+        session_free(s);
+    } else {
+        session_arm(s, EPOLL_CTL_MOD);
+    }
+}
+
+// 为新连接创建会话并写入欢迎信息
+Session *session_new(int fd) {
+    Session *s = calloc(1, sizeof(Session));
+    if (s == NULL) return NULL;
+    s->fd = fd;
+    s->id = atomic_fetch_add(&next_session_id, 1);
+    s->phase = PHASE_PLAYERS;
+    s->pending = -1;
+    s->rng = (uint32_t)time(NULL) ^ (0x9E3779B9u * (uint32_t)s->id);
+    s->channel = channel_new(s->id);
+    atomic_fetch_add(&live_sessions, 1);
+    
+    session_begin(s);
+    game_printf("欢迎来到大富翁简化版游戏! (第 %d 局)\n", s->id);
+    game_printf("请输入玩家数量 (2-4): ");
+    session_end(s);
+    return s;
+}
+
+// 接受所有等待中的连接
+void server_accept() {
+    for (;;) {
+        int fd = accept4(server_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) perror("accept4");
+            return;
+        }
+        
+        Session *s = session_new(fd);
+        if (s == NULL) {
+            close(fd);
+            continue;
+        }
+        session_flush(s);
+        session_arm(s, EPOLL_CTL_ADD);
+    }
+}
+
+void *server_worker(void *arg) {
+    (void)arg;
+    struct epoll_event events[SERVER_EVENTS];
+    
+    serving = 1;
+    sim_policy = greedy_policy;
+    for (;;) {
+        int n = epoll_wait(server_epoll, events, SERVER_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            return NULL;
+        }
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.ptr == NULL) {
+                server_accept();
+            } else {
+                session_event(events[i].data.ptr, events[i].events);
+            }
+        }
+    }
+}
+
+// ----- io_uring 后端 -----
+// 每个工作线程一个 ring，各自在监听套接字上挂一个多次 accept。
+// 每个会话挂一个多次 recv，数据放在向内核注册的缓冲区环中，处理完立即归还；
+// 输出用 IORING_OP_SEND 发出，每个会话同时最多一个发送。
+// 新的请求在一轮完成事件处理完后一次性提交，提交和等待合并为一次 io_uring_enter。
+
+#define URING_ENTRIES 1024
+#define URING_BUFS 1024          // 缓冲区环大小，必须是2的幂
+#define URING_BUF_SIZE 512
+#define URING_BGID 0
+
+// user_data 低两位表示请求类型，其余位是会话指针
+enum { URING_ACCEPT, URING_RECV, URING_SEND, URING_CANCEL };
+
+typedef struct {
+    int fd;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+    unsigned sq_local_tail;   // 已填写但尚未提交的 SQE 的尾部
+    unsigned to_submit;
+    struct io_uring_buf_ring *br;
+    char *bufs;
+    unsigned short br_tail;
+} Uring;
+
+int uring_setup(Uring *u) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+    params.cq_entries = URING_ENTRIES * 8;
+    u->fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+    if (u->fd < 0 && errno == EINVAL) {
+        // 旧内核不支持 SINGLE_ISSUER / DEFER_TASKRUN
+        memset(&params, 0, sizeof(params));
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = URING_ENTRIES * 8;
+        u->fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+    }
+    if (u->fd < 0) {
+        perror("io_uring_setup");
+        return -1;
+    }
+    
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (cq_size > sq_size) sq_size = cq_size;
+        cq_size = sq_size;
+    }
+    char *sq = mmap(NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+    char *cq = sq;
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        cq = mmap(NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_CQ_RING);
+    }
+    u->sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+    if (sq == MAP_FAILED || cq == MAP_FAILED || u->sqes == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+    u->sq_head = (unsigned *)(sq + params.sq_off.head);
+    u->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    u->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    u->sq_array = (unsigned *)(sq + params.sq_off.array);
+    u->cq_head = (unsigned *)(cq + params.cq_off.head);
+    u->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    u->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    u->sq_local_tail = *u->sq_tail;
+    u->to_submit = 0;
+    
+    // 注册接收缓冲区环
+    size_t ring_size = URING_BUFS * sizeof(struct io_uring_buf);
+    u->br = mmap(NULL, ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    u->bufs = xmalloc((size_t)URING_BUFS * URING_BUF_SIZE);
+    if (u->br == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)u->br;
+    reg.ring_entries = URING_BUFS;
+    reg.bgid = URING_BGID;
+    if (syscall(__NR_io_uring_register, u->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        perror("IORING_REGISTER_PBUF_RING");
+        return -1;
+    }
+    u->br_tail = 0;
+    for (int i = 0; i < URING_BUFS; i++) {
+        struct io_uring_buf *b = &u->br->bufs[u->br_tail & (URING_BUFS - 1)];
+        b->addr = (uint64_t)(uintptr_t)(u->bufs + (size_t)i * URING_BUF_SIZE);
+        b->len = URING_BUF_SIZE;
+        b->bid = i;
+        u->br_tail++;
+    }
+    __atomic_store_n(&u->br->tail, u->br_tail, __ATOMIC_RELEASE);
+    return 0;
+}
+
+// 把用完的接收缓冲区归还给内核
+void uring_recycle(Uring *u, int bid) {
+    struct io_uring_buf *b = &u->br->bufs[u->br_tail & (URING_BUFS - 1)];
+    b->addr = (uint64_t)(uintptr_t)(u->bufs + (size_t)bid * URING_BUF_SIZE);
+    b->len = URING_BUF_SIZE;
+    b->bid = bid;
+    u->br_tail++;
+    __atomic_store_n(&u->br->tail, u->br_tail, __ATOMIC_RELEASE);
+}
+
+int uring_enter(Uring *u, unsigned min_complete) {
+    __atomic_store_n(u->sq_tail, u->sq_local_tail, __ATOMIC_RELEASE);
+    unsigned flags = min_complete ? IORING_ENTER_GETEVENTS : 0;
+    int ret = syscall(__NR_io_uring_enter, u->fd, u->to_submit, min_complete, flags, NULL, 0);
+    if (ret >= 0) {
+        u->to_submit -= ret < (int)u->to_submit ? (unsigned)ret : u->to_submit;
+    } else if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+        perror("io_uring_enter");
+    }
+    return ret;
+}
+
+// 取一个空闲的 SQE，提交队列满时先提交已有的请求
+struct io_uring_sqe *uring_sqe(Uring *u, int op, Session *s) {
+    while (u->sq_local_tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) >= URING_ENTRIES) {
+        uring_enter(u, 0);
+    }
+    unsigned index = u->sq_local_tail & *u->sq_mask;
+    struct io_uring_sqe *sqe = &u->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->user_data = (uint64_t)(uintptr_t)s | op;
+    u->sq_array[index] = index;
+    u->sq_local_tail++;
+    u->to_submit++;
+    return sqe;
+}
+
+void uring_accept(Uring *u) {
+    struct io_uring_sqe *sqe = uring_sqe(u, URING_ACCEPT, NULL);
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = server_fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+}
+
+void uring_recv(Uring *u, Session *s) {
+    struct io_uring_sqe *sqe = uring_sqe(u, URING_RECV, s);
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = s->fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BGID;
+    s->receiving = 1;
+}
+
+// 没有发送中的数据时，把 out 换到 wire 上发出
+void uring_send(Uring *u, Session *s) {
+    if (s->sending || s->dead) return;
+    if (s->out_sent >= s->wire.len) {
+        if (s->out.len == 0) return;
+        OutBuf t = s->wire;
+        s->wire = s->out;
+        s->out = t;
+        s->out.len = 0;
+        s->out_sent = 0;
+    }
+    struct io_uring_sqe *sqe = uring_sqe(u, URING_SEND, s);
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = s->fd;
+    sqe->addr = (uint64_t)(uintptr_t)(s->wire.data + s->out_sent);
+    sqe->len = s->wire.len - s->out_sent;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    s->sending = 1;
+}
+
+// 请求全部完成后释放会话；游戏结束且输出已发完时关闭连接，让多次 recv 结束
+void uring_settle(Uring *u, Session *s) {
+    // 旁观者：取消多次 recv，输出发完后移交给旁观线程
+    if (!s->dead && s->phase == PHASE_WATCH) {
+        if (s->receiving) {
+            if (!s->cancelling) {
+                struct io_uring_sqe *sqe = uring_sqe(u, URING_CANCEL, NULL);
+                sqe->opcode = IORING_OP_ASYNC_CANCEL;
+                sqe->addr = (uint64_t)(uintptr_t)s | URING_RECV;
+                s->cancelling = 1;
+            }
+            return;
+        }
+        if (!s->sending && s->out_sent >= s->wire.len && s->out.len == 0) {
+            spectator_attach(s);
+            return;
+        }
+    }
+    if (!s->dead && s->phase == PHASE_CLOSING && !s->sending && s->out.len == 0) {
+        s->dead = 1;
+    }
+    if (s->dead && s->receiving) {
+        shutdown(s->fd, SHUT_RDWR);
+        return;
+    }
+    if (s->dead && !s->sending && !s->receiving) {
+        session_free(s);
+        return;
+    }
+    uring_send(u, s);
+}
+
+void uring_complete(Uring *u, struct io_uring_cqe *cqe) {
+    int op = cqe->user_data & 3;
+    Session *s = (Session *)(uintptr_t)(cqe->user_data & ~(uint64_t)3);
+    int more = cqe->flags & IORING_CQE_F_MORE;
+    
+    switch (op) {
+        case URING_ACCEPT:
+            if (cqe->res >= 0) {
+                Session *n = session_new(cqe->res);
+                if (n == NULL) {
+                    close(cqe->res);
+                } else {
+                    uring_recv(u, n);
+                    uring_send(u, n);
+                }
+            }
+            if (!more) uring_accept(u);
+            return;
+        case URING_RECV:
+            if (cqe->res > 0) {
+                int bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+                if (!s->dead) {
+                    session_begin(s);
+                    session_feed(s, u->bufs + (size_t)bid * URING_BUF_SIZE, cqe->res);
+                    session_end(s);
+                }
+                uring_recycle(u, bid);
+            }
+            if (!more) {
+                s->receiving = 0;
+                // 缓冲区暂时用完时重新挂上接收，其余情况说明连接已关闭
+                if (cqe->res == -ENOBUFS && !s->dead && s->phase != PHASE_WATCH) {
+                    uring_recv(u, s);
+                } else if (s->phase != PHASE_WATCH) {
+                    s->dead = 1;
+                }
+            }
+            break;
+        case URING_CANCEL:
+            return;
+        case URING_SEND:
+            s->sending = 0;
+            if (cqe->res < 0) {
+                s->dead = 1;
+            } else {
+                s->out_sent += cqe->res;
+            }
+            break;
+    }
+    uring_settle(u, s);
+}
+
+void *uring_worker(void *arg) {
+    (void)arg;
+    Uring u;
+    
+    serving = 1;
+    sim_policy = greedy_policy;
+    if (uring_setup(&u) < 0) exit(1);
+    uring_accept(&u);
+    for (;;) {
+        uring_enter(&u, 1);
+        unsigned head = *u.cq_head;
+        unsigned tail = __atomic_load_n(u.cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            uring_complete(&u, &u.cqes[head & *u.cq_mask]);
+            head++;
+            if (head == tail) {
+                // 处理期间新到的完成事件一并处理
+                __atomic_store_n(u.cq_head, head, __ATOMIC_RELEASE);
+                tail = __atomic_load_n(u.cq_tail, __ATOMIC_ACQUIRE);
+            }
+        }
+        __atomic_store_n(u.cq_head, head, __ATOMIC_RELEASE);
+    }
+}
+
+// ----- 负载生成器 -----
+// 模拟大量按脚本操作的客户端：根据服务器的提示回答，回合命令随机选择
+// roll / step / block，游戏结束后重新连接，直到发完规定数量的命令。
+// 记录每行输入从发出到收到下一个提示的延迟。
+
+#define LOADGEN_TAIL 48
+
+typedef struct {
+    int fd;
+    uint32_t rng;
+    int cmds_left;
+    char tail[LOADGEN_TAIL];   // 最近收到的输出，用于识别提示
+    int tail_len;
+    double sent_at;
+} LoadClient;
+
+typedef struct {
+    const char *path;
+    LoadClient *clients;
+    int count;
+    int cmds;
+    long commands;     // 已完成的回合命令数
+    long games;
+    double *latency;   // 每行输入的往返延迟 (ms)
+    long samples;
+    long cap;
+} LoadJob;
+
+int loadgen_clients = 1000;
+int loadgen_cmds = 100;
+int loadgen_threads = 4;
+
+int loadgen_connect(const char *path) {
+    struct sockaddr_un addr;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int ends_with(const char *text, int len, const char *suffix) {
+    int n = strlen(suffix);
+    return len >= n && memcmp(text + len - n, suffix, n) == 0;
+}
+
+// 根据提示决定下一行输入，返回 0 表示该客户端的命令已经发完
+int loadgen_reply(LoadJob *job, LoadClient *c, char *line, size_t size) {
+    const char *t = c->tail;
+    int n = c->tail_len;
+    uint32_t r = c->rng = c->rng * 1664525u + 1013904223u;
+    
+    if (ends_with(t, n, "(2-4): ")) {
+        snprintf(line, size, "2\n");
+    } else if (ends_with(t, n, "(默认10000): ")) {
+        snprintf(line, size, "10000\n");
+    } else if (ends_with(t, n, "(y/n): ")) {
+        snprintf(line, size, "%c\n", (r >> 16) % 4 ? 'y' : 'n');
+    } else if (ends_with(t, n, "道具编号: ")) {
+        snprintf(line, size, "%u\n", (r >> 16) % 4);
+    } else if (ends_with(t, n, "查看帮助): ")) {
+        if (c->cmds_left == 0) return 0;
+        c->cmds_left--;
+        job->commands++;
+        int pick = (r >> 16) % 20;
+        if (pick < 14) {
+            snprintf(line, size, "roll\n");
+        } else if (pick < 17) {
+            snprintf(line, size, "step %u\n", 1 + (r >> 8) % 6);
+        } else {
+            int d = 1 + (r >> 8) % 10;
+            snprintf(line, size, "block %d\n", (r & 1) ? d : -d);
+        }
+    } else {
+        line[0] = '\0';   // 提示还没有收全
+    }
+    return 1;
+}
+
+void *loadgen_worker(void *arg) {
+    LoadJob *job = arg;
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    int active = 0;
+    
+    for (int i = 0; i < job->count; i++) {
+        LoadClient *c = &job->clients[i];
+        c->fd = loadgen_connect(job->path);
+        if (c->fd < 0) {
+            perror("connect");
+            continue;
+        }
+        c->sent_at = now_ms();
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+        epoll_ctl(ep, EPOLL_CTL_ADD, c->fd, &ev);
+        active++;
+    }
+    
+    struct epoll_event events[SERVER_EVENTS];
+    char buf[8192];
+    while (active > 0) {
+        int n = epoll_wait(ep, events, SERVER_EVENTS, -1);
+        for (int i = 0; i < n; i++) {
+            LoadClient *c = events[i].data.ptr;
+            ssize_t len = recv(c->fd, buf, sizeof(buf), MSG_DONTWAIT);
+            if (len < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+            if (len <= 0) {
+                // 游戏结束，服务器关闭了连接：还有命令要发就重新开一局
+                close(c->fd);
+                job->games++;
+                c->tail_len = 0;
+                c->fd = c->cmds_left > 0 ? loadgen_connect(job->path) : -1;
+                if (c->fd < 0) {
+                    active--;
+                    continue;
+                }
+                c->sent_at = now_ms();
+                struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+                epoll_ctl(ep, EPOLL_CTL_ADD, c->fd, &ev);
+                continue;
+            }
+            
+            if (len >= LOADGEN_TAIL) {
+                memcpy(c->tail, buf + len - LOADGEN_TAIL, LOADGEN_TAIL);
+                c->tail_len = LOADGEN_TAIL;
+            } else {
+                int keep = c->tail_len + len > LOADGEN_TAIL ? LOADGEN_TAIL - len : c->tail_len;
+                memmove(c->tail, c->tail + c->tail_len - keep, keep);
+                memcpy(c->tail + keep, buf, len);
+                c->tail_len = keep + len;
+            }
+            
+            char line[32];
+            if (!loadgen_reply(job, c, line, sizeof(line))) {
+                close(c->fd);
+                c->fd = -1;
+                active--;
+                continue;
+            }
+            if (line[0] == '\0') continue;
+            
+            double now = now_ms();
+            if (job->samples < job->cap) job->latency[job->samples++] = now - c->sent_at;
+            c->sent_at = now;
+            c->tail_len = 0;
+            send(c->fd, line, strlen(line), MSG_NOSIGNAL);
+        }
+    }
+    close(ep);
+    return NULL;
+}
+
+int double_compare(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// 负载生成器入口：连接 path 上的服务器，输出吞吐量和延迟分布
+void loadgen_main(const char *path) {
+    int threads = loadgen_threads < 1 ? 1 : loadgen_threads;
+    if (threads > MAX_SEARCH_THREADS) threads = MAX_SEARCH_THREADS;
+    if (threads > loadgen_clients) threads = loadgen_clients;
+    signal(SIGPIPE, SIG_IGN);
+    
+    LoadClient *clients = xmalloc(sizeof(LoadClient) * loadgen_clients);
+    LoadJob jobs[MAX_SEARCH_THREADS];
+    pthread_t tids[MAX_SEARCH_THREADS];
+    for (int i = 0; i < loadgen_clients; i++) {
+        clients[i].rng = 12345u + 0x9E3779B9u * (uint32_t)i;
+        clients[i].cmds_left = loadgen_cmds;
+        clients[i].tail_len = 0;
+    }
+    
+    double start = now_ms();
+    int first = 0;
+    for (int t = 0; t < threads; t++) {
+        int count = loadgen_clients / threads + (t < loadgen_clients % threads);
+        LoadJob *job = &jobs[t];
+        memset(job, 0, sizeof(*job));
+        job->path = path;
+        job->clients = clients + first;
+        job->count = count;
+        // 每条命令还会引出若干决策回答和开局输入
+        job->cap = (long)count * loadgen_cmds * 2 + 1024;
+        job->latency = xmalloc(sizeof(double) * job->cap);
+        first += count;
+        pthread_create(&tids[t], NULL, loadgen_worker, job);
+    }
+    
+    long commands = 0, games = 0, samples = 0;
+    for (int t = 0; t < threads; t++) {
+        pthread_join(tids[t], NULL);
+        commands += jobs[t].commands;
+        games += jobs[t].games;
+        samples += jobs[t].samples;
+    }
+    double elapsed = (now_ms() - start) / 1000.0;
+    
+    double *all = xmalloc(sizeof(double) * (samples + 1));
+    long k = 0;
+    for (int t = 0; t < threads; t++) {
+        memcpy(all + k, jobs[t].latency, sizeof(double) * jobs[t].samples);
+        k += jobs[t].samples;
+        free(jobs[t].latency);
+    }
+    qsort(all, samples, sizeof(double), double_compare);
+    
+    printf("客户端 %d, 命令 %ld, 输入行 %ld, 对局 %ld, 用时 %.2f 秒\n",
+           loadgen_clients, commands, samples, games, elapsed);
+    printf("吞吐量: %.0f 命令/秒, %.0f 行/秒\n", commands / elapsed, samples / elapsed);
+    if (samples > 0) {
+        printf("延迟 (ms): p50 %.3f  p90 %.3f  p99 %.3f  max %.3f\n",
+               all[samples / 2], all[samples * 9 / 10], all[samples * 99 / 100], all[samples - 1]);
+    }
+    free(all);
+    free(clients);
+}
+
+// 服务器入口：在 path 上监听，直到进程被终止
+int server_main(const char *path) {
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "套接字路径过长: %s\n", path);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    
+    // io_uring 后端使用阻塞套接字，由内核在就绪时完成请求
+    server_fd = socket(AF_UNIX, SOCK_STREAM | (server_uring ? 0 : SOCK_NONBLOCK) | SOCK_CLOEXEC, 0);
+    if (server_fd < 0) {
+        perror("socket");
+        return 1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+    if (bind(server_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(server_fd, SOMAXCONN) < 0) {
+        perror(path);
+        return 1;
+    }
+    
+    void *(*worker)(void *) = uring_worker;
+    if (!server_uring) {
+        worker = server_worker;
+        server_epoll = epoll_create1(EPOLL_CLOEXEC);
+        if (server_epoll < 0) {
+            perror("epoll_create1");
+            return 1;
+        }
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = NULL;
+        if (epoll_ctl(server_epoll, EPOLL_CTL_ADD, server_fd, &ev) < 0) {
+            perror("epoll_ctl");
+            return 1;
+        }
+    }
+    
+    int threads = server_threads > 0 ? server_threads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) threads = 1;
+    if (threads > MAX_SEARCH_THREADS) threads = MAX_SEARCH_THREADS;
+    fprintf(stderr, "服务器在 %s 上监听, %d 个工作线程 (%s)\n", path, threads, server_uring ? "io_uring" : "epoll");
+    
+    if (checkpoint_path) {
+        server_restore_load();
+        pthread_t tid;
+        pthread_create(&tid, NULL, checkpoint_worker, NULL);
+        pthread_detach(tid);
+    }
+    
+    pthread_t tids[MAX_SEARCH_THREADS];
+    for (int t = 1; t < threads; t++) {
+        pthread_create(&tids[t], NULL, worker, NULL);
+    }
+    worker(NULL);
+    return 1;
+}
+
+void usage(const char *prog) {
+    fprintf(stderr, "用法: %s [选项]\n", prog);
+    fprintf(stderr, "  --bots N          后N个座位为电脑玩家\n");
+    fprintf(stderr, "  --think-ms N      电脑玩家每次决策的思考时间\n");
+    fprintf(stderr, "  --threads N       搜索线程数\n");
+    fprintf(stderr, "  --tt-mb N         置换表大小\n");
+    fprintf(stderr, "  --simd-bench N    对比标量与SIMD批量模拟N局\n");
+    fprintf(stderr, "  --markov          计算各格子的落点概率\n");
+    fprintf(stderr, "  --markov-cells N  落点概率使用N格的地图\n");
+    fprintf(stderr, "  --markov-turns N  同时计算从起点出发前N回合的期望落点次数\n");
+    fprintf(stderr, "  --hold-h N        落在医院停留N回合\n");
+    fprintf(stderr, "  --hold-p N        落在监狱停留N回合\n");
+    fprintf(stderr, "  --sweep grid|ga   扫描地产价格与过路费\n");
+    fprintf(stderr, "  --sweep-games N   每个参数点的模拟局数\n");
+    fprintf(stderr, "  --sweep-prices lo:hi:step  网格搜索的价格范围\n");
+    fprintf(stderr, "  --sweep-ratios a,b,...     网格搜索的过路费/价格比例\n");
+    fprintf(stderr, "  --sweep-pop N --sweep-gens N  遗传搜索的种群大小和代数\n");
+    fprintf(stderr, "  --sweep-top N     输出最好的N组参数\n");
+    fprintf(stderr, "  --sweep-cache F   参数点结果缓存文件\n");
+    fprintf(stderr, "  --mass N          大规模模式: N 名玩家的批量规则压测\n");
+    fprintf(stderr, "  --mass-cells N    大规模模式的格子数 (默认每名玩家 %d 格)\n", TOTAL_CELLS / MAX_PLAYERS);
+    fprintf(stderr, "  --mass-rounds N   大规模模式进行的轮数 (默认%d)\n", MASS_ROUNDS);
+    fprintf(stderr, "  --mass-spread     大规模模式的玩家均匀分布在地图上出发\n");
+    fprintf(stderr, "  --mass-spec N     大规模模式每批推测执行N个回合 (线程数由 --threads 指定)\n");
+    fprintf(stderr, "  --mass-resume PATH  从检查点 PATH 继续大规模模式\n");
+    fprintf(stderr, "  --checkpoint PATH 大规模模式和服务器定期把状态写到 PATH (fork 子进程写出)\n");
+    fprintf(stderr, "  --checkpoint-ms N 检查点间隔 (默认1000毫秒)\n");
+    fprintf(stderr, "  --profile         统计回合各阶段的用时, 输入 prof 或发送 SIGUSR1 时输出\n");
+    fprintf(stderr, "  --shm NAME        把局面导出到共享内存 NAME (如 /rich)\n");
+    fprintf(stderr, "  --shm-watch NAME  从共享内存读取并显示局面\n");
+    fprintf(stderr, "  --shm-interval MS 读者刷新间隔, 0 表示连续读取并校验 (默认200)\n");
+    fprintf(stderr, "  --server PATH     在 Unix 域套接字上运行多会话游戏服务器\n");
+    fprintf(stderr, "  --server-threads N  服务器工作线程数\n");
+    fprintf(stderr, "  --server-uring    服务器使用 io_uring 后端 (默认 epoll)\n");
+    fprintf(stderr, "  --loadgen PATH    对 PATH 上的服务器运行负载生成器\n");
+    fprintf(stderr, "  --loadgen-clients N  模拟客户端数量 (默认1000)\n");
+    fprintf(stderr, "  --loadgen-cmds N  每个客户端发送的回合命令数 (默认100)\n");
+    fprintf(stderr, "  --loadgen-threads N  负载生成器线程数 (默认4)\n");
+}
+
+int main(int argc, char *argv[]) {
+    int simd_games = 0;
+    int markov = 0;
+    int markov_cells = TOTAL_CELLS;
+    int markov_turns = 0;
+    const char *sweep_mode = NULL;
+    int sweep_lo = 100, sweep_hi = 600, sweep_step = 100;
+    const char *sweep_ratios = "0.3,0.5,0.7";
+    int sweep_pop = 32, sweep_gens = 20, sweep_top = 10;
+    const char *server_path = NULL;
+    const char *loadgen_path = NULL;
+    const char *shm_export_name = NULL, *shm_watch_name = NULL;
+    int mass_players = 0, mass_cells = 0, mass_rounds = 0, mass_spread = 0, mass_spec = 0;
+    const char *mass_resume = NULL;
+    int profile = 0;
+    
+    init_zobrist();
+    
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bots") == 0 && i + 1 < argc) {
+            bot_count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--think-ms") == 0 && i + 1 < argc) {
+            bot_think_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            bot_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--tt-mb") == 0 && i + 1 < argc) {
+            tt_mb = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--simd-bench") == 0 && i + 1 < argc) {
+            simd_games = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--markov") == 0) {
+            markov = 1;
+        } else if (strcmp(argv[i], "--markov-cells") == 0 && i + 1 < argc) {
+            markov = 1;
+            markov_cells = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--markov-turns") == 0 && i + 1 < argc) {
+            markov = 1;
+            markov_turns = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--hold-h") == 0 && i + 1 < argc) {
+            hold_hospital = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--hold-p") == 0 && i + 1 < argc) {
+            hold_prison = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--sweep") == 0 && i + 1 < argc) {
+            sweep_mode = argv[++i];
+            if (strcmp(sweep_mode, "grid") != 0 && strcmp(sweep_mode, "ga") != 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--sweep-games") == 0 && i + 1 < argc) {
+            sweep_games = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--sweep-prices") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%d:%d:%d", &sweep_lo, &sweep_hi, &sweep_step) != 3) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--sweep-ratios") == 0 && i + 1 < argc) {
+            sweep_ratios = argv[++i];
+        } else if (strcmp(argv[i], "--sweep-pop") == 0 && i + 1 < argc) {
+            sweep_pop = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--sweep-gens") == 0 && i + 1 < argc) {
+            sweep_gens = atoi(argv[++i]);
+            if (sweep_gens < 1) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--sweep-top") == 0 && i + 1 < argc) {
+            sweep_top = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--sweep-cache") == 0 && i + 1 < argc) {
+            sweep_cache_file = argv[++i];
+        } else if (strcmp(argv[i], "--mass") == 0 && i + 1 < argc) {
+            mass_players = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--mass-cells") == 0 && i + 1 < argc) {
+            mass_cells = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--mass-rounds") == 0 && i + 1 < argc) {
+            mass_rounds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--mass-spread") == 0) {
+            mass_spread = 1;
+        } else if (strcmp(argv[i], "--mass-spec") == 0 && i + 1 < argc) {
+            mass_spec = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--mass-resume") == 0 && i + 1 < argc) {
+            mass_resume = argv[++i];
+        } else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+            checkpoint_path = argv[++i];
+        } else if (strcmp(argv[i], "--checkpoint-ms") == 0 && i + 1 < argc) {
+            checkpoint_ms = atoi(argv[++i]);
+            if (checkpoint_ms < 1) checkpoint_ms = 1;
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            profile = 1;
+        } else if (strcmp(argv[i], "--shm") == 0 && i + 1 < argc) {
+            shm_export_name = argv[++i];
+        } else if (strcmp(argv[i], "--shm-watch") == 0 && i + 1 < argc) {
+            shm_watch_name = argv[++i];
+        } else if (strcmp(argv[i], "--shm-interval") == 0 && i + 1 < argc) {
+            shm_interval_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--server") == 0 && i + 1 < argc) {
+            server_path = argv[++i];
+        } else if (strcmp(argv[i], "--server-threads") == 0 && i + 1 < argc) {
+            server_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--server-uring") == 0) {
+            server_uring = 1;
+        } else if (strcmp(argv[i], "--loadgen") == 0 && i + 1 < argc) {
+            loadgen_path = argv[++i];
+        } else if (strcmp(argv[i], "--loadgen-clients") == 0 && i + 1 < argc) {
+            loadgen_clients = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--loadgen-cmds") == 0 && i + 1 < argc) {
+            loadgen_cmds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--loadgen-threads") == 0 && i + 1 < argc) {
+            loadgen_threads = atoi(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    
+    if (shm_watch_name) {
+        return shm_watch(shm_watch_name);
+    } else if (mass_players > 0 || mass_resume) {
+        mass_main(mass_players, mass_cells, mass_rounds, mass_spread, mass_spec, mass_resume);
+    } else if (server_path) {
+        return server_main(server_path);
+    } else if (loadgen_path) {
+        if (loadgen_clients < 1) loadgen_clients = 1;
+        loadgen_main(loadgen_path);
+    } else if (simd_games > 0) {
+        sim_benchmark(simd_games);
+    } else if (markov) {
+        markov_report(markov_cells, markov_turns);
+    } else if (sweep_mode) {
+        if (sweep_games < 1) sweep_games = 1;
+        if (sweep_pop < 2) sweep_pop = 2;
+        sweep_main(sweep_mode, sweep_lo, sweep_hi, sweep_step, sweep_ratios,
+                   sweep_pop, sweep_gens, sweep_top);
+    } else {
+        if (shm_export_name && shm_export(shm_export_name) < 0) return 1;
+        if (profile) prof_start();
+        game_loop();
+        shm_close();
+    }
+    return 0;
+}
@@ -0,0 +1,355 @@
+// 规则引擎微基准：把某个版本的源文件整个包含进来（main 改名），直接调用其中的函数计时。
+// 三个版本的 position_to_coord、display_map、handle_position、use_* 等函数签名相同，
+// 同一份基准可以比较 Rich.1.0.c、Rich1.3.c 和 Rich2.0.c：
+//
+//     gcc -O2 -DRICH_SOURCE='"Rich2.0.c"' -pthread -o bench bench.c -lm
+//     ./bench --samples 30 > bench_rich2.0.json
+//
+// 游戏输出重定向到 /dev/null，需要输入的询问从 /dev/zero 读取（一律回答“否”）。
+// 每个基准先预热并确定每个样本的调用次数（样本至少 --min-ms 毫秒），再采集 --samples 个样本，
+// 报告每次调用的纳秒数。结果以固定字段顺序的 JSON 写到标准输出，进度写到标准错误。
+
+#define _GNU_SOURCE
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#ifndef RICH_SOURCE
+#define RICH_SOURCE "Rich2.0.c"
+#endif
+
+#define main rich_main
+#include RICH_SOURCE
+#undef main
+
+#include <math.h>
+
+// Rich2.0.c 起用 rng_seed 和 end_turn 管理随机数和回合，它也是第一个定义 TOTAL_CELLS 的版本
+#ifdef TOTAL_CELLS
+#define BENCH_CELLS TOTAL_CELLS
+#else
+#define BENCH_CELLS (2 * (MAP_ROWS + MAP_COLS - 2))
+#endif
+
+#define BENCH_MAX 32
+#define BENCH_MAX_BATCH (1 << 24)
+
+typedef struct {
+    char name[48];
+    void (*setup)(int arg);   // 每个样本开始前调用，不计时
+    void (*op)(int arg);      // 被计时的一次调用
+    int arg;
+} Bench;
+
+// 统计结果（每次调用的纳秒数）
+typedef struct {
+    int batch;
+    double min;
+    double median;
+    double mean;
+    double stddev;
+    double p90;
+    double max;
+} BenchStats;
+
+Bench benches[BENCH_MAX];
+int bench_count;
+volatile int bench_sink;      // 防止编译器把结果优化掉
+
+// 以下格子编号在 bench_register 中按地图查找
+int bench_target;             // 道具基准放置道具的格子
+int bench_target_row, bench_target_col;
+
+void bench_seed() {
+#ifdef TOTAL_CELLS
+    rng_seed(12345);
+#else
+    srand(12345);
+#endif
+}
+
+void bench_new_game() {
+    init_map();
+    init_players(4, 10000);
+    current_player = 0;
+    game_over = 0;
+    bench_seed();
+}
+
+void bench_end_turn() {
+#ifdef TOTAL_CELLS
+    end_turn();
+#else
+    current_player = (current_player + 1) % player_count;
+#endif
+}
+
+double bench_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// ----- 基准 -----
+
+void setup_game(int arg) {
+    (void)arg;
+    bench_new_game();
+}
+
+void op_position_to_coord(int arg) {
+    (void)arg;
+    static int position;
+    int row, col;
+    position_to_coord(position, &row, &col);
+    position = position + 1 == BENCH_CELLS ? 0 : position + 1;
+    bench_sink += row + col;
+}
+
+void op_display_map(int arg) {
+    (void)arg;
+    display_map();
+}
+
+// handle_position 的参数：格子编号 * 4 + 地主（0 空地, 1 自己, 2 他人）
+void op_handle_position(int arg) {
+    int position = arg >> 2;
+    int row, col;
+    position_to_coord(position, &row, &col);
+    Cell *cell = &map[row][col];
+    switch (arg & 3) {
+        case 0: cell->owner = -1; cell->level = 0; break;
+        case 1: cell->owner = 0; cell->level = 1; break;
+        case 2: cell->owner = 1; cell->level = 1; break;
+    }
+    cell->has_item = 0;
+    players[0].position = position;
+    players[0].money = 10000;
+    players[0].points = 1000;
+    players[0].item_count = 0;
+    handle_position(0);
+}
+
+// 道具基准：给玩家 0 一个道具，使用后清掉放下的道具，保证每次调用走同一条路径
+void op_use_block(int arg) {
+    (void)arg;
+    players[0].items[0] = 1;
+    players[0].item_count = 1;
+    use_block(0, bench_target - players[0].position);
+    map[bench_target_row][bench_target_col].has_item = 0;
+}
+
+void op_use_bomb(int arg) {
+    (void)arg;
+    players[0].items[0] = 3;
+    players[0].item_count = 1;
+    use_bomb(0, bench_target - players[0].position);
+    map[bench_target_row][bench_target_col].has_item = 0;
+}
+
+void op_use_robot(int arg) {
+    (void)arg;
+    players[0].items[0] = 2;
+    players[0].item_count = 1;
+    map[bench_target_row][bench_target_col].has_item = 1;
+    map[bench_target_row][bench_target_col].item_type = 1;
+    use_robot(0);
+}
+
+// 不经过输入的完整回合：掷骰子、移动、落点处理、切换玩家；对局结束时重新开局
+void op_turn(int arg) {
+    (void)arg;
+    if (game_over) bench_new_game();
+    int p = current_player;
+    move_player(p, roll_dice());
+    handle_position(p);
+    bench_end_turn();
+}
+
+void bench_add(const char *name, void (*setup)(int), void (*op)(int), int arg) {
+    Bench *b = &benches[bench_count++];
+    snprintf(b->name, sizeof(b->name), "%s", name);
+    b->setup = setup;
+    b->op = op;
+    b->arg = arg;
+}
+
+// 第一个类型为 type 的格子，没有时返回 -1
+int bench_find(char type) {
+    for (int i = 0; i < BENCH_CELLS; i++) {
+        int row, col;
+        position_to_coord(i, &row, &col);
+        if (map[row][col].type == type) return i;
+    }
+    return -1;
+}
+
+void bench_register() {
+    bench_new_game();
+    bench_target = 3;
+    position_to_coord(bench_target, &bench_target_row, &bench_target_col);
+    
+    bench_add("position_to_coord", setup_game, op_position_to_coord, 0);
+    bench_add("display_map", setup_game, op_display_map, 0);
+    
+    // 各版本地图上没有的格子类型跳过
+    static const char types[] = "STGM$HP";
+    char name[48];
+    int land = bench_find('O');
+    if (land >= 0) {
+        bench_add("handle_position/O_empty", setup_game, op_handle_position, land * 4 + 0);
+        bench_add("handle_position/O_own", setup_game, op_handle_position, land * 4 + 1);
+        bench_add("handle_position/O_toll", setup_game, op_handle_position, land * 4 + 2);
+    }
+    for (const char *t = types; *t; t++) {
+        int position = bench_find(*t);
+        if (position < 0) continue;
+        snprintf(name, sizeof(name), "handle_position/%c", *t);
+        bench_add(name, setup_game, op_handle_position, position * 4);
+    }
+    
+    bench_add("use_block", setup_game, op_use_block, 0);
+    bench_add("use_bomb", setup_game, op_use_bomb, 0);
+    bench_add("use_robot", setup_game, op_use_robot, 0);
+    bench_add("turn", setup_game, op_turn, 0);
+}
+
+// ----- 计时与统计 -----
+
+double bench_sample(const Bench *b, int batch) {
+    b->setup(b->arg);
+    double start = bench_now_ns();
+    for (int i = 0; i < batch; i++) {
+        b->op(b->arg);
+    }
+    return (bench_now_ns() - start) / batch;
+}
+
+int bench_compare(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+void bench_run(const Bench *b, int samples, int warmup, double min_ns, BenchStats *st) {
+    // 预热，同时把每个样本的调用次数加倍到样本至少 min_ns
+    int batch = 1;
+    while (batch < BENCH_MAX_BATCH && bench_sample(b, batch) * batch < min_ns) {
+        batch *= 2;
+    }
+    for (int i = 0; i < warmup; i++) {
+        bench_sample(b, batch);
+    }
+    
+    double *ns = malloc(sizeof(double) * samples);
+    if (ns == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    double sum = 0;
+    for (int i = 0; i < samples; i++) {
+        ns[i] = bench_sample(b, batch);
+        sum += ns[i];
+    }
+    qsort(ns, samples, sizeof(double), bench_compare);
+    
+    st->batch = batch;
+    st->min = ns[0];
+    st->max = ns[samples - 1];
+    st->median = samples % 2 ? ns[samples / 2] : (ns[samples / 2 - 1] + ns[samples / 2]) / 2;
+    st->p90 = ns[(int)ceil(0.9 * samples) - 1];
+    st->mean = sum / samples;
+    double var = 0;
+    for (int i = 0; i < samples; i++) {
+        var += (ns[i] - st->mean) * (ns[i] - st->mean);
+    }
+    st->stddev = samples > 1 ? sqrt(var / (samples - 1)) : 0;
+    free(ns);
+}
+
+void bench_json(FILE *out, int samples, int warmup, double min_ms, const BenchStats *stats) {
+    fprintf(out, "{\n");
+    fprintf(out, "  \"variant\": \"%s\",\n", RICH_SOURCE);
+    fprintf(out, "  \"compiler\": \"%s\",\n", __VERSION__);
+    fprintf(out, "  \"unit\": \"ns/op\",\n");
+    fprintf(out, "  \"samples\": %d,\n", samples);
+    fprintf(out, "  \"warmup\": %d,\n", warmup);
+    fprintf(out, "  \"min_sample_ms\": %.3f,\n", min_ms);
+    fprintf(out, "  \"benchmarks\": [\n");
+    for (int i = 0; i < bench_count; i++) {
+        const BenchStats *st = &stats[i];
+        if (st->batch == 0) continue;
+        fprintf(out, "    {\"name\": \"%s\", \"batch\": %d, \"min\": %.3f, \"median\": %.3f, "
+                "\"mean\": %.3f, \"stddev\": %.3f, \"p90\": %.3f, \"max\": %.3f}",
+                benches[i].name, st->batch, st->min, st->median, st->mean, st->stddev, st->p90, st->max);
+        int last = 1;
+        for (int j = i + 1; j < bench_count; j++) {
+            if (stats[j].batch) last = 0;
+        }
+        fprintf(out, last ? "\n" : ",\n");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+void bench_usage(const char *prog) {
+    fprintf(stderr, "用法: %s [选项]\n", prog);
+    fprintf(stderr, "  --samples N   每个基准采集的样本数 (默认20)\n");
+    fprintf(stderr, "  --warmup N    确定调用次数后再预热的样本数 (默认3)\n");
+    fprintf(stderr, "  --min-ms N    每个样本的最短时间 (默认2毫秒)\n");
+    fprintf(stderr, "  --filter STR  只运行名称包含 STR 的基准\n");
+    fprintf(stderr, "  --list        列出所有基准\n");
+}
+
+int main(int argc, char *argv[]) {
+    int samples = 20, warmup = 3, list = 0;
+    double min_ms = 2;
+    const char *filter = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+            samples = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            warmup = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--min-ms") == 0 && i + 1 < argc) {
+            min_ms = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "--list") == 0) {
+            list = 1;
+        } else {
+            bench_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (samples < 1) samples = 1;
+    if (warmup < 0) warmup = 0;
+    
+    // 游戏输出丢弃，询问从 /dev/zero 读取
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    int zero_fd = open("/dev/zero", O_RDONLY);
+    if (saved_stdout < 0 || null_fd < 0 || zero_fd < 0) {
+        perror("open");
+        return 1;
+    }
+    dup2(null_fd, STDOUT_FILENO);
+    dup2(zero_fd, STDIN_FILENO);
+    
+    bench_register();
+    BenchStats stats[BENCH_MAX];
+    memset(stats, 0, sizeof(stats));
+    for (int i = 0; i < bench_count; i++) {
+        if (filter && strstr(benches[i].name, filter) == NULL) continue;
+        if (list) {
+            fprintf(stderr, "%s\n", benches[i].name);
+            continue;
+        }
+        bench_run(&benches[i], samples, warmup, min_ms * 1e6, &stats[i]);
+        fprintf(stderr, "%-28s %12.1f ns/op  (中位数, 标准差 %.1f, 每样本 %d 次)\n",
+                benches[i].name, stats[i].median, stats[i].stddev, stats[i].batch);
+    }
+    
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    if (!list) bench_json(stdout, samples, warmup, min_ms, stats);
+    return 0;
+}
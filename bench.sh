@@ -0,0 +1,14 @@
+#!/bin/sh
+# 分别编译三个版本的微基准并运行，结果写到 输出目录/版本名.json
+# 用法: ./bench.sh [输出目录] [bench 选项...]
+set -e
+cd "$(dirname "$0")"
+out=${1:-bench_results}
+[ $# -gt 0 ] && shift
+mkdir -p "$out"
+for src in Rich.1.0.c Rich1.3.c Rich2.0.c; do
+    name=$(basename "$src" .c)
+    gcc -O2 -DRICH_SOURCE="\"$src\"" -pthread -o "$out/bench_$name" bench.c -lm
+    echo "== $src" >&2
+    "$out/bench_$name" "$@" > "$out/$name.json"
+done
@@ -0,0 +1,244 @@
+#ifndef KEYDECODE_H
+#define KEYDECODE_H
+
+// 终端按键解码: 逐字节输入, 状态保存在解码器中, 转义序列分几次读到也能正确拼接。
+// main.c 和 raw_mode_editor.c 共用
+
+// 特殊按键定义
+#define KEY_UP 1000
+#define KEY_DOWN 1001
+#define KEY_RIGHT 1002
+#define KEY_LEFT 1003
+#define KEY_PAGE_UP 1004
+#define KEY_PAGE_DOWN 1005
+#define KEY_HOME 1006
+#define KEY_END 1007
+#define KEY_DEL 1008
+#define KEY_ESC 0x1b
+
+// 单独的 ESC 之后等待后续字节的默认时间 (毫秒), 超时就当作 ESC 键
+#define KD_ESC_TIMEOUT_MS 25
+
+// 已收到 ESC [ 或 ESC O 之后等待其余字节的时间 (毫秒), 超时丢弃这个不完整的序列
+#define KD_SEQ_TIMEOUT_MS 1000
+
+// 一次 kdFeed / kdFlush 最多产生的按键数
+#define KD_MAX_OUT 16
+
+// 解码状态
+enum {
+    KD_GROUND,    // 普通字节
+    KD_ESC,       // 收到 ESC
+    KD_CSI,       // ESC [ 之后, 读取数字参数直到结束字节
+    KD_SS3,       // ESC O 之后, 下一个字节是结束字节
+    KD_STATES
+};
+
+// 字节分类
+enum {
+    KD_C_ESC,       // 0x1b
+    KD_C_BRACKET,   // '['
+    KD_C_O,         // 'O'
+    KD_C_DIGIT,     // '0'..'9'
+    KD_C_SEP,       // ';'
+    KD_C_MID,       // 0x20..0x3f 中的其他字节, 序列中的参数或中间字节
+    KD_C_FINAL,     // 0x40..0x7e 中的其他字节, 可以结束一个序列
+    KD_C_OTHER,     // 控制字符和 0x7f 以上的字节, 不会出现在序列中
+    KD_CLASSES
+};
+
+// 动作
+enum {
+    KD_EMIT,        // 作为普通按键交出
+    KD_START,       // 开始一个转义序列
+    KD_ENTER,       // 进入下一个状态
+    KD_PARAM,       // 累加数字参数
+    KD_NEXT,        // 开始下一个参数
+    KD_DONE,        // 序列结束, 查表得到按键
+    KD_ABORT,       // 不是转义序列: 交出 ESC, 再按普通状态重新处理这个字节
+    KD_DROP         // 序列被打断: 丢弃已收到的部分, 再按普通状态重新处理这个字节
+};
+
+struct kdTransition {
+    unsigned char action;
+    unsigned char next;
+};
+
+// 状态转移表: [状态][字节分类]
+static const struct kdTransition kdTable[KD_STATES][KD_CLASSES] = {
+    [KD_GROUND] = {
+        [KD_C_ESC] = {KD_START, KD_ESC},
+        [KD_C_BRACKET] = {KD_EMIT, KD_GROUND},
+        [KD_C_O] = {KD_EMIT, KD_GROUND},
+        [KD_C_DIGIT] = {KD_EMIT, KD_GROUND},
+        [KD_C_SEP] = {KD_EMIT, KD_GROUND},
+        [KD_C_MID] = {KD_EMIT, KD_GROUND},
+        [KD_C_FINAL] = {KD_EMIT, KD_GROUND},
+        [KD_C_OTHER] = {KD_EMIT, KD_GROUND},
+    },
+    [KD_ESC] = {
+        [KD_C_ESC] = {KD_ABORT, KD_GROUND},
+        [KD_C_BRACKET] = {KD_ENTER, KD_CSI},
+        [KD_C_O] = {KD_ENTER, KD_SS3},
+        [KD_C_DIGIT] = {KD_ABORT, KD_GROUND},
+        [KD_C_SEP] = {KD_ABORT, KD_GROUND},
+        [KD_C_MID] = {KD_ABORT, KD_GROUND},
+        [KD_C_FINAL] = {KD_ABORT, KD_GROUND},
+        [KD_C_OTHER] = {KD_ABORT, KD_GROUND},
+    },
+    [KD_CSI] = {
+        [KD_C_ESC] = {KD_DROP, KD_GROUND},
+        [KD_C_BRACKET] = {KD_DONE, KD_GROUND},
+        [KD_C_O] = {KD_DONE, KD_GROUND},
+        [KD_C_DIGIT] = {KD_PARAM, KD_CSI},
+        [KD_C_SEP] = {KD_NEXT, KD_CSI},
+        [KD_C_MID] = {KD_ENTER, KD_CSI},
+        [KD_C_FINAL] = {KD_DONE, KD_GROUND},
+        [KD_C_OTHER] = {KD_DROP, KD_GROUND},
+    },
+    [KD_SS3] = {
+        [KD_C_ESC] = {KD_DROP, KD_GROUND},
+        [KD_C_BRACKET] = {KD_DONE, KD_GROUND},
+        [KD_C_O] = {KD_DONE, KD_GROUND},
+        [KD_C_DIGIT] = {KD_DONE, KD_GROUND},
+        [KD_C_SEP] = {KD_DONE, KD_GROUND},
+        [KD_C_MID] = {KD_DONE, KD_GROUND},
+        [KD_C_FINAL] = {KD_DONE, KD_GROUND},
+        [KD_C_OTHER] = {KD_DROP, KD_GROUND},
+    },
+};
+
+// ESC [ 和 ESC O 之后结束字节对应的按键
+static const int kdFinalKeys[128] = {
+    ['A'] = KEY_UP,
+    ['B'] = KEY_DOWN,
+    ['C'] = KEY_RIGHT,
+    ['D'] = KEY_LEFT,
+    ['H'] = KEY_HOME,
+    ['F'] = KEY_END,
+};
+
+// ESC [ n ~ 中参数 n 对应的按键
+static const int kdTildeKeys[] = {
+    [1] = KEY_HOME,
+    [3] = KEY_DEL,
+    [4] = KEY_END,
+    [5] = KEY_PAGE_UP,
+    [6] = KEY_PAGE_DOWN,
+    [7] = KEY_HOME,
+    [8] = KEY_END,
+};
+
+struct keyDecoder {
+    int state;
+    int param;                  // 第一个数字参数, 其后的参数 (修饰键) 忽略
+    int nparam;                 // 已开始的参数个数
+};
+
+static inline void kdInit(struct keyDecoder *d) {
+    d->state = KD_GROUND;
+    d->param = 0;
+    d->nparam = 0;
+}
+
+static inline int kdClass(int c) {
+    if (c == 0x1b) return KD_C_ESC;
+    if (c == '[') return KD_C_BRACKET;
+    if (c == 'O') return KD_C_O;
+    if (c >= '0' && c <= '9') return KD_C_DIGIT;
+    if (c == ';') return KD_C_SEP;
+    if (c >= 0x20 && c <= 0x3f) return KD_C_MID;
+    if (c >= 0x40 && c <= 0x7e) return KD_C_FINAL;
+    return KD_C_OTHER;
+}
+
+// 查表得到序列对应的按键, 不认识的序列返回 -1
+static inline int kdLookup(const struct keyDecoder *d, int final) {
+    if (d->state == KD_CSI && final == '~') {
+        int n = sizeof(kdTildeKeys) / sizeof(kdTildeKeys[0]);
+        if (d->param < n && kdTildeKeys[d->param]) return kdTildeKeys[d->param];
+        return -1;
+    }
+    if (final < 128 && kdFinalKeys[final]) return kdFinalKeys[final];
+    return -1;
+}
+
+// 输入一个字节, 解出的按键写入 out (至少 KD_MAX_OUT 个), 返回按键数。
+// 序列没有结束时返回 0, 状态保留到下一次调用
+static inline int kdFeed(struct keyDecoder *d, unsigned char c, int *out) {
+    int n = 0;
+    const struct kdTransition *t = &kdTable[d->state][kdClass(c)];
+    
+    switch (t->action) {
+        case KD_EMIT:
+            out[n++] = c;
+            break;
+        case KD_START:
+            d->param = d->nparam = 0;
+            break;
+        case KD_ENTER:
+            break;
+        case KD_PARAM:
+            if (d->nparam == 0) d->nparam = 1;
+            if (d->nparam == 1 && d->param < 10000) d->param = d->param * 10 + (c - '0');
+            break;
+        case KD_NEXT:
+            d->nparam++;
+            break;
+        case KD_DONE: {
+            int key = kdLookup(d, c);
+            if (key != -1) out[n++] = key;
+            break;
+        }
+        case KD_ABORT:
+            // 前面的 ESC 是单独按下的, 这个字节重新开始解码
+            out[n++] = KEY_ESC;
+            d->state = KD_GROUND;
+            return n + kdFeed(d, c, out + n);
+        case KD_DROP:
+            d->state = KD_GROUND;
+            return kdFeed(d, c, out);
+    }
+    d->state = t->next;
+    return n;
+}
+
+// 是否停在一个未结束的序列中; 调用者应等待后续字节, 超时后调用 kdFlush
+static inline int kdPending(const struct keyDecoder *d) {
+    return d->state != KD_GROUND;
+}
+
+// 等待后续字节的时间 (毫秒): 单独的 ESC 等 escMs, 已进入序列时等 KD_SEQ_TIMEOUT_MS, 不需要等待时返回 -1
+static inline int kdTimeout(const struct keyDecoder *d, int escMs) {
+    if (d->state == KD_ESC) return escMs;
+    if (d->state != KD_GROUND) return KD_SEQ_TIMEOUT_MS;
+    return -1;
+}
+
+// 等待超时: 单独的 ESC 交出为 ESC 键; 已收到 ESC [ 或 ESC O 的不完整序列直接丢弃,
+// 以免网络延迟把方向键拆成 ESC 和普通字符
+static inline int kdFlush(struct keyDecoder *d, int *out) {
+    int n = 0;
+    if (d->state == KD_ESC) out[n++] = KEY_ESC;
+    kdInit(d);
+    return n;
+}
+
+// 特殊按键的名字, 普通字节返回 NULL
+static inline const char *kdKeyName(int key) {
+    switch (key) {
+        case KEY_UP: return "UP";
+        case KEY_DOWN: return "DOWN";
+        case KEY_RIGHT: return "RIGHT";
+        case KEY_LEFT: return "LEFT";
+        case KEY_PAGE_UP: return "PAGE_UP";
+        case KEY_PAGE_DOWN: return "PAGE_DOWN";
+        case KEY_HOME: return "HOME";
+        case KEY_END: return "END";
+        case KEY_DEL: return "DEL";
+        case KEY_ESC: return "ESC";
+    }
+    return NULL;
+}
+
+#endif
@@ -1,13 +1,24 @@
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <termios.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 
+#include "keydecode.h"
+
 // 保存原始终端设置
 static struct termios orig_termios;
 
@@ -54,8 +65,8 @@ void enableRawMode() {
                    | ISIG);  // 禁用信号处理
     
     // 控制字符设置 (c_cc)
-    raw.c_cc[VMIN] = 0;      // 最小读取字符数
-    raw.c_cc[VTIME] = 1;     // 100ms超时
+    raw.c_cc[VMIN] = 0;      // 读取立即返回已到达的字节
+    raw.c_cc[VTIME] = 0;     // 等待输入由 poll 完成
     
     // 应用修改后的终端设置
     if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) == -1) {
@@ -63,50 +74,1210 @@ void enableRawMode() {
     }
 }
 
-// 特殊按键定义
-#define KEY_UP 1000
-#define KEY_DOWN 1001
-#define KEY_RIGHT 1002
-#define KEY_LEFT 1003
-#define KEY_PAGE_UP 1004
-#define KEY_PAGE_DOWN 1005
-#define KEY_HOME 1006
-#define KEY_END 1007
-#define KEY_DEL 1008
-#define KEY_ESC 0x1b
+// 控制键
+#define CTRL_KEY(k) ((k) & 0x1f)
+
+// 每次向后建立索引时扫描的字节数
+#define INDEX_BLOCK 65536
+
+// 不超过这个大小的文件默认逐行放进间隙缓冲区, 更大的文件用片段表
+#define GAP_MAX_FILE (16 << 20)
+
+// 文件的行索引: 只扫描到显示需要的位置
+struct lineIndex {
+    size_t *start;    // 每行的起始偏移
+    long count;       // 已知的行数
+    long cap;
+    size_t scanned;   // 已扫描到的文件偏移
+};
+
+// 片段表中的一个片段, 指向原文件或追加缓冲区中的一段。
+// 片段按文档顺序组成树堆, 每个结点缓存子树的字节数和换行符数
+struct piece {
+    struct piece *left, *right;
+    unsigned prio;
+    int add;          // 1 表示在追加缓冲区中
+    size_t start;
+    size_t len;
+    size_t lf;        // 片段中的换行符数
+    size_t sum_len;
+    size_t sum_lf;
+};
+
+// 片段表: 只读的原文件加上只追加的缓冲区。
+// 原文件中只有已建立索引的前缀 [0, covered) 并入树中, 其余部分原样接在文档末尾
+struct pieceTable {
+    struct piece *root;
+    char *add;
+    size_t addlen;
+    size_t addcap;
+    struct lineIndex addidx;  // 追加缓冲区的行索引
+    size_t covered;
+    long covered_line;        // covered 处是原文件的第几行
+};
+
+// 一行文本的间隙缓冲区: 内容分成间隙前后两段, 插入和删除只在间隙处进行
+struct gapLine {
+    char *buf;
+    int cap;
+    int gap_start;
+    int gap_end;
+};
+
+// 按行存放的间隙缓冲区文档
+struct gapBuffer {
+    struct gapLine *lines;
+    long count;
+    long cap;
+};
+
+// 绳索的结点: 叶子保存一段文本, 内部结点缓存子树的字节数和换行符数, 按 AVL 规则保持平衡
+struct ropeNode {
+    struct ropeNode *left, *right;  // 叶子结点都为 NULL
+    char *data;       // 叶子的内容, 未修改过的叶子直接指向文件映射
+    int owned;        // data 是否为自己分配的内存
+    int height;
+    size_t bytes;
+    size_t lf;
+};
+
+// 文本后端: 编辑器只通过这些操作读写文档, 行列都按字节计
+struct textBackend {
+    const char *name;
+    long (*rows)(long want);          // 确保前 want + 1 行已知, 返回已知行数
+    int (*complete)(void);            // 行数是否已全部知道
+    int (*lineLength)(long row);
+    int (*read)(long row, int col, char *dst, int n);
+    void (*insert)(long row, int col, const char *s, size_t len);
+    void (*erase)(long row, int col, size_t len);   // 可以跨过行尾
+    long long (*write)(int fd);       // 写出整个文档, 返回字节数, 出错时返回 -1
+};
 
 // 编辑器状态
 struct editorState {
-    int screenrows;
+    int screenrows;   // 文本区行数, 不含状态栏
     int screencols;
-    int cursor_x;
-    int cursor_y;
+    int cursor_x;     // 光标在文件中的列
+    long cursor_y;    // 光标在文件中的行
+    long rowoff;      // 第一行显示的文件行
+    int coloff;       // 第一列显示的文件列
+    char *filename;
+    const char *map;  // mmap 映射的文件内容
+    size_t size;
+    struct lineIndex idx;
+    struct pieceTable pt;
+    struct gapBuffer gap;
+    struct ropeNode *rope;
+    const struct textBackend *buf;
+    int dirty;
+    char statusmsg[80];
+    time_t statusmsg_time;
 };
 
 struct editorState E;
 
-// 追加缓冲区结构
+// 并行建立索引的线程数, 0 表示按 CPU 个数
+int scanThreads = 0;
+
+// --frame-stats: 在状态栏显示上一帧的输出字节数和分配次数
+int frameStats = 0;
+int lastFrameBytes = 0;
+int lastFrameAllocs = 0;
+
+// --backend 指定的文本后端, 为空时按文件大小选择
+const char *backendName = NULL;
+
+// 追加缓冲区结构, 容量按倍数增长, 各帧之间复用
 struct appendBuffer {
     char *b;
     int len;
+    int cap;
 };
 
-#define AB_INIT {NULL, 0}
+#define AB_INIT {NULL, 0, 0}
+
+// 本帧追加缓冲区扩容的次数, 稳定后应为 0
+int abAllocs = 0;
 
 // 向追加缓冲区添加内容
 void abAppend(struct appendBuffer *ab, const char *s, int len) {
-    char *new = realloc(ab->b, ab->len + len);
-    if (new == NULL) return;
-    memcpy(&new[ab->len], s, len);
-    ab->b = new;
+    if (ab->len + len > ab->cap) {
+        int cap = ab->cap ? ab->cap : 4096;
+        while (ab->len + len > cap) cap *= 2;
+        char *new = realloc(ab->b, cap);
+        if (new == NULL) return;
+        ab->b = new;
+        ab->cap = cap;
+        abAllocs++;
+    }
+    memcpy(&ab->b[ab->len], s, len);
     ab->len += len;
 }
 
+// 清空内容但保留内存, 供下一帧使用
+void abReset(struct appendBuffer *ab) {
+    ab->len = 0;
+}
+
 // 释放追加缓冲区
 void abFree(struct appendBuffer *ab) {
     free(ab->b);
+    ab->b = NULL;
+    ab->len = ab->cap = 0;
+}
+
+// 确保索引还能再放下 n 个行首
+void indexReserve(struct lineIndex *li, long n) {
+    if (li->count + n <= li->cap) return;
+    while (li->count + n > li->cap) {
+        li->cap = li->cap ? li->cap * 2 : 1024;
+    }
+    li->start = realloc(li->start, li->cap * sizeof(size_t));
+    if (li->start == NULL) die("realloc");
+}
+
+// 追加一个行首偏移
+void indexPush(struct lineIndex *li, size_t offset) {
+    indexReserve(li, 1);
+    li->start[li->count++] = offset;
+}
+
+// 在 p[0, len) 中查找换行符, 把下一行的行首 (base + 换行符位置 + 1) 依次写入 out, 返回个数。
+// out 至少要能放下 len 个偏移
+typedef size_t (*scanFunc)(const char *p, size_t len, size_t base, size_t *out);
+
+size_t scanScalar(const char *p, size_t len, size_t base, size_t *out) {
+    size_t n = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (p[i] == '\n') out[n++] = base + i + 1;
+    }
+    return n;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+// 每 16 字节比较一次, 比较结果的位掩码中每个 1 是一个换行符
+__attribute__((target("sse2")))
+size_t scanSse2(const char *p, size_t len, size_t base, size_t *out) {
+    const __m128i nl = _mm_set1_epi8('\n');
+    size_t n = 0, i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+        unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, nl));
+        while (mask) {
+            out[n++] = base + i + __builtin_ctz(mask) + 1;
+            mask &= mask - 1;
+        }
+    }
+    return n + scanScalar(p + i, len - i, base + i, out + n);
+}
+
+// 每次处理 64 字节, 两个 32 字节的掩码拼成一个 64 位掩码
+__attribute__((target("avx2,bmi")))
+size_t scanAvx2(const char *p, size_t len, size_t base, size_t *out) {
+    const __m256i nl = _mm256_set1_epi8('\n');
+    size_t n = 0, i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(p + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(p + i + 32));
+        uint64_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, nl))
+                      | (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(b, nl)) << 32;
+        while (mask) {
+            out[n++] = base + i + _tzcnt_u64(mask) + 1;
+            mask = _blsr_u64(mask);
+        }
+    }
+    return n + scanScalar(p + i, len - i, base + i, out + n);
+}
+#endif
+
+struct scanVariant {
+    const char *name;
+    scanFunc fn;
+    int supported;
+};
+
+struct scanVariant scanVariants[] = {
+    {"scalar", scanScalar, 1},
+#if defined(__x86_64__) || defined(__i386__)
+    {"sse2", scanSse2, 0},
+    {"avx2", scanAvx2, 0},
+#endif
+};
+
+#define SCAN_VARIANTS (int)(sizeof(scanVariants) / sizeof(scanVariants[0]))
+
+// 当前使用的扫描函数, 启动时选 CPU 支持的最宽指令集
+scanFunc scanNewlines = scanScalar;
+
+void initScanner() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    scanVariants[1].supported = __builtin_cpu_supports("sse2");
+    scanVariants[2].supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi");
+#endif
+    for (int v = 0; v < SCAN_VARIANTS; v++) {
+        if (scanVariants[v].supported) scanNewlines = scanVariants[v].fn;
+    }
+}
+
+// 把 [from, to) 中的行首追加到索引, 每次最多扫描一块
+void indexScan(struct lineIndex *li, const char *map, size_t from, size_t to) {
+    while (from < to) {
+        size_t len = to - from < INDEX_BLOCK ? to - from : INDEX_BLOCK;
+        indexReserve(li, len);
+        li->count += scanNewlines(map + from, len, from, li->start + li->count);
+        from += len;
+    }
+    li->scanned = to;
+}
+
+// 向后扫描一块文件内容
+void indexScanBlock() {
+    size_t end = E.idx.scanned + INDEX_BLOCK;
+    if (end > E.size) end = E.size;
+    indexScan(&E.idx, E.map, E.idx.scanned, end);
+}
+
+struct scanChunk {
+    pthread_t tid;
+    size_t from, to;
+    struct lineIndex li;
+};
+
+void *scanWorker(void *arg) {
+    struct scanChunk *c = arg;
+    indexScan(&c->li, E.map, c->from, c->to);
+    return NULL;
+}
+
+// 扫描文件的剩余部分: 分成 threads 段并行建立索引, 再按顺序拼接到已有索引之后
+void indexAll(int threads) {
+    size_t from = E.idx.scanned;
+    size_t rest = E.size - from;
+    if (threads < 1) threads = 1;
+    if ((size_t)threads > rest / INDEX_BLOCK) threads = rest / INDEX_BLOCK;
+    if (threads <= 1) {
+        indexScan(&E.idx, E.map, from, E.size);
+        return;
+    }
+    
+    struct scanChunk chunks[threads];
+    for (int t = 0; t < threads; t++) {
+        chunks[t].from = from + rest * t / threads;
+        chunks[t].to = from + rest * (t + 1) / threads;
+        chunks[t].li = (struct lineIndex){NULL, 0, 0, 0};
+        if (pthread_create(&chunks[t].tid, NULL, scanWorker, &chunks[t]) != 0) die("pthread_create");
+    }
+    for (int t = 0; t < threads; t++) {
+        pthread_join(chunks[t].tid, NULL);
+        indexReserve(&E.idx, chunks[t].li.count);
+        memcpy(E.idx.start + E.idx.count, chunks[t].li.start, chunks[t].li.count * sizeof(size_t));
+        E.idx.count += chunks[t].li.count;
+        free(chunks[t].li.start);
+    }
+    E.idx.scanned = E.size;
+}
+
+// 确保前 want + 1 行都已建立索引, 返回已知的行数。
+// 文件末尾的换行符之后还有一个空行
+long indexLines(long want) {
+    while (E.idx.count <= want && E.idx.scanned < E.size) {
+        indexScanBlock();
+    }
+    return E.idx.count;
+}
+
+// 整个文件是否都已扫描
+int indexComplete() {
+    return E.idx.scanned == E.size;
+}
+
+// 原文件第 row 行的范围, 不含行尾的换行符
+void lineRange(long row, size_t *start, size_t *end) {
+    indexLines(row + 1);
+    *start = E.idx.start[row];
+    *end = row + 1 < E.idx.count ? E.idx.start[row + 1] - 1 : E.size;
+}
+
+// 用 mmap 打开文件, 内容按需由内核换入, 行索引也只在显示时向后扩展
+void openFile(const char *filename) {
+    free(E.filename);
+    E.filename = strdup(filename);
+    
+    // 文件不存在时从空文档开始, 保存时创建
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1 && errno == ENOENT) return;
+    if (fd == -1) die(filename);
+    struct stat st;
+    if (fstat(fd, &st) == -1) die("fstat");
+    
+    E.size = st.st_size;
+    if (E.size > 0) {
+        E.map = mmap(NULL, E.size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (E.map == MAP_FAILED) die("mmap");
+    }
+    close(fd);
+}
+
+// 片段表
+
+size_t sumLen(struct piece *t) {
+    return t ? t->sum_len : 0;
+}
+
+size_t sumLf(struct piece *t) {
+    return t ? t->sum_lf : 0;
+}
+
+void pieceUpdate(struct piece *t) {
+    t->sum_len = sumLen(t->left) + t->len + sumLen(t->right);
+    t->sum_lf = sumLf(t->left) + t->lf + sumLf(t->right);
+}
+
+struct lineIndex *pieceIndex(int add) {
+    return add ? &E.pt.addidx : &E.idx;
+}
+
+const char *pieceData(struct piece *t) {
+    return t->add ? E.pt.add + t->start : E.map + t->start;
+}
+
+// 索引中不大于 offset 的行首个数
+long indexUpper(struct lineIndex *li, size_t offset) {
+    long lo = 0, hi = li->count;
+    while (lo < hi) {
+        long mid = (lo + hi) / 2;
+        if (li->start[mid] <= offset) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// 缓冲区中 [from, to) 的换行符数, 由行索引二分查找得到
+size_t spanLf(int add, size_t from, size_t to) {
+    struct lineIndex *li = pieceIndex(add);
+    return indexUpper(li, to) - indexUpper(li, from);
+}
+
+struct piece *pieceNew(int add, size_t start, size_t len, size_t lf) {
+    struct piece *t = malloc(sizeof(struct piece));
+    if (t == NULL) die("malloc");
+    t->left = t->right = NULL;
+    t->prio = rand();
+    t->add = add;
+    t->start = start;
+    t->len = len;
+    t->lf = lf;
+    pieceUpdate(t);
+    return t;
+}
+
+void pieceFree(struct piece *t) {
+    if (t == NULL) return;
+    pieceFree(t->left);
+    pieceFree(t->right);
+    free(t);
+}
+
+// 按文档偏移把树分成前 off 字节和其余部分, 偏移落在片段中间时把片段一分为二
+void pieceSplit(struct piece *t, size_t off, struct piece **l, struct piece **r) {
+    if (t == NULL) {
+        *l = *r = NULL;
+        return;
+    }
+    size_t ll = sumLen(t->left);
+    if (off <= ll) {
+        pieceSplit(t->left, off, l, &t->left);
+        pieceUpdate(t);
+        *r = t;
+    } else if (off >= ll + t->len) {
+        pieceSplit(t->right, off - ll - t->len, &t->right, r);
+        pieceUpdate(t);
+        *l = t;
+    } else {
+        // 右半段接替原结点的优先级, 仍然满足堆序
+        size_t k = off - ll;
+        size_t lf = spanLf(t->add, t->start, t->start + k);
+        struct piece *n = pieceNew(t->add, t->start + k, t->len - k, t->lf - lf);
+        n->prio = t->prio;
+        n->right = t->right;
+        pieceUpdate(n);
+        t->len = k;
+        t->lf = lf;
+        t->right = NULL;
+        pieceUpdate(t);
+        *l = t;
+        *r = n;
+    }
+}
+
+struct piece *pieceMerge(struct piece *l, struct piece *r) {
+    if (l == NULL) return r;
+    if (r == NULL) return l;
+    if (l->prio > r->prio) {
+        l->right = pieceMerge(l->right, r);
+        pieceUpdate(l);
+        return l;
+    }
+    r->left = pieceMerge(l, r->left);
+    pieceUpdate(r);
+    return r;
+}
+
+// 文档偏移 off 处结束的片段如果正好接在缓冲区的 end 之前, 就原地延长 len 字节。
+// 连续输入的字符因此只占一个片段
+int pieceGrow(struct piece *t, size_t off, int add, size_t end, size_t len, size_t lf) {
+    if (t == NULL) return 0;
+    size_t ll = sumLen(t->left);
+    int ok;
+    if (off <= ll) {
+        ok = pieceGrow(t->left, off, add, end, len, lf);
+    } else if (off == ll + t->len) {
+        ok = t->add == add && t->start + t->len == end;
+        if (ok) {
+            t->len += len;
+            t->lf += lf;
+        }
+    } else if (off > ll + t->len) {
+        ok = pieceGrow(t->right, off - ll - t->len, add, end, len, lf);
+    } else {
+        ok = 0;
+    }
+    if (ok) {
+        t->sum_len += len;
+        t->sum_lf += lf;
+    }
+    return ok;
+}
+
+// 在文档偏移 off 处插入一个片段, 能接到前一个片段上时不新建结点
+void pieceInsert(size_t off, int add, size_t start, size_t len, size_t lf) {
+    if (pieceGrow(E.pt.root, off, add, start, len, lf)) return;
+    struct piece *l, *r;
+    pieceSplit(E.pt.root, off, &l, &r);
+    E.pt.root = pieceMerge(pieceMerge(l, pieceNew(add, start, len, lf)), r);
+}
+
+// 第 k 个换行符之后的文档偏移, 即树中第 k 行的行首
+size_t pieceLineStart(size_t k) {
+    struct piece *t = E.pt.root;
+    size_t off = 0;
+    if (k == 0) return 0;
+    while (t) {
+        size_t l = sumLf(t->left);
+        if (k <= l) {
+            t = t->left;
+            continue;
+        }
+        k -= l;
+        off += sumLen(t->left);
+        if (k <= t->lf) {
+            struct lineIndex *li = pieceIndex(t->add);
+            return off + li->start[indexUpper(li, t->start) + k - 1] - t->start;
+        }
+        k -= t->lf;
+        off += t->len;
+        t = t->right;
+    }
+    return off;
+}
+
+// 复制文档 [off, off + n) 的内容, 返回复制的字节数
+size_t pieceCopy(struct piece *t, size_t off, size_t n, char *dst) {
+    if (t == NULL || n == 0) return 0;
+    size_t ll = sumLen(t->left);
+    size_t done = 0;
+    if (off < ll) {
+        done = pieceCopy(t->left, off, n, dst);
+    }
+    if (done < n && off + done >= ll && off + done < ll + t->len) {
+        size_t from = off + done - ll;
+        size_t k = t->len - from < n - done ? t->len - from : n - done;
+        memcpy(dst + done, pieceData(t) + from, k);
+        done += k;
+    }
+    if (done < n && off + done >= ll + t->len) {
+        done += pieceCopy(t->right, off + done - ll - t->len, n - done, dst + done);
+    }
+    return done;
+}
+
+// 把原文件中未并入的部分向后并入树中, 直到树里至少有 rows 个换行符或到达文件末尾
+void ptCover(long rows) {
+    long lf = sumLf(E.pt.root);
+    if (lf >= rows || E.pt.covered == E.size) return;
+    
+    long line = E.pt.covered_line + (rows - lf);
+    size_t to;
+    if (indexLines(line) > line) {
+        to = E.idx.start[line];
+    } else {
+        to = E.size;
+        line = E.idx.count - 1;
+    }
+    pieceInsert(sumLen(E.pt.root), 0, E.pt.covered, to - E.pt.covered, line - E.pt.covered_line);
+    E.pt.covered = to;
+    E.pt.covered_line = line;
+}
+
+// 文档第 row 行的范围, 不含换行符。
+// 行在树中时返回 1 和文档偏移, 在未并入的原文件部分时返回 0 和原文件偏移
+int ptRowSpan(long row, size_t *start, size_t *end) {
+    long lf = sumLf(E.pt.root);
+    if (row < lf || (row == lf && E.pt.covered == E.size)) {
+        *start = pieceLineStart(row);
+        *end = row < lf ? pieceLineStart(row + 1) - 1 : sumLen(E.pt.root);
+        return 1;
+    }
+    lineRange(E.pt.covered_line + (row - lf), start, end);
+    return 0;
+}
+
+// 确保前 want + 1 行都已知, 返回已知的行数
+long ptRows(long want) {
+    long lf = sumLf(E.pt.root);
+    if (E.pt.covered == E.size) return lf + 1;
+    long tail = want > lf ? want - lf : 0;
+    return lf + indexLines(E.pt.covered_line + tail) - E.pt.covered_line;
+}
+
+// 行数是否已全部知道
+int ptComplete(void) {
+    return E.pt.covered == E.size || indexComplete();
+}
+
+int ptLineLength(long row) {
+    size_t start, end;
+    ptRowSpan(row, &start, &end);
+    return end - start;
+}
+
+// 复制第 row 行从 col 列起的最多 n 个字节
+int ptRead(long row, int col, char *dst, int n) {
+    size_t start, end;
+    int intree = ptRowSpan(row, &start, &end);
+    if (end - start <= (size_t)col) return 0;
+    if (end - start - col < (size_t)n) n = end - start - col;
+    if (intree) return pieceCopy(E.pt.root, start + col, n, dst);
+    memcpy(dst, E.map + start + col, n);
+    return n;
+}
+
+// 在第 row 行第 col 列插入文本。
+// 编辑前把本行和下一行并入树中, 所以改动不会碰到树中最后一个换行符
+void ptInsert(long row, int col, const char *s, size_t len) {
+    ptCover(row + 2);
+    size_t off = pieceLineStart(row) + col;
+    
+    if (E.pt.addlen + len > E.pt.addcap) {
+        while (E.pt.addlen + len > E.pt.addcap) {
+            E.pt.addcap = E.pt.addcap ? E.pt.addcap * 2 : 4096;
+        }
+        E.pt.add = realloc(E.pt.add, E.pt.addcap);
+        if (E.pt.add == NULL) die("realloc");
+    }
+    size_t at = E.pt.addlen;
+    memcpy(E.pt.add + at, s, len);
+    E.pt.addlen += len;
+    
+    long before = E.pt.addidx.count;
+    indexScan(&E.pt.addidx, E.pt.add, at, at + len);
+    pieceInsert(off, 1, at, len, E.pt.addidx.count - before);
+}
+
+// 删除第 row 行第 col 列起的 len 个字节, 可以跨过行尾
+void ptErase(long row, int col, size_t len) {
+    ptCover(row + 2);
+    size_t off = pieceLineStart(row) + col;
+    struct piece *l, *m, *r;
+    pieceSplit(E.pt.root, off, &l, &r);
+    pieceSplit(r, len, &m, &r);
+    pieceFree(m);
+    E.pt.root = pieceMerge(l, r);
+}
+
+int writeAll(int fd, const char *p, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+int pieceWrite(int fd, struct piece *t) {
+    if (t == NULL) return 0;
+    if (pieceWrite(fd, t->left) == -1) return -1;
+    if (writeAll(fd, pieceData(t), t->len) == -1) return -1;
+    return pieceWrite(fd, t->right);
+}
+
+// 按顺序写出所有片段和未并入的原文件部分
+long long ptWrite(int fd) {
+    if (pieceWrite(fd, E.pt.root) == -1) return -1;
+    if (writeAll(fd, E.map + E.pt.covered, E.size - E.pt.covered) == -1) return -1;
+    return sumLen(E.pt.root) + E.size - E.pt.covered;
+}
+
+const struct textBackend pieceBackend = {
+    "piece", ptRows, ptComplete, ptLineLength, ptRead, ptInsert, ptErase, ptWrite
+};
+
+// 间隙缓冲区
+
+int gapLength(struct gapLine *l) {
+    return l->cap - (l->gap_end - l->gap_start);
+}
+
+// 把间隙移到 col 处, 只搬动两者之间的字节
+void gapMove(struct gapLine *l, int col) {
+    if (col < l->gap_start) {
+        int n = l->gap_start - col;
+        memmove(l->buf + l->gap_end - n, l->buf + col, n);
+        l->gap_start -= n;
+        l->gap_end -= n;
+    } else if (col > l->gap_start) {
+        int n = col - l->gap_start;
+        memmove(l->buf + l->gap_start, l->buf + l->gap_end, n);
+        l->gap_start += n;
+        l->gap_end += n;
+    }
+}
+
+// 确保间隙至少有 n 字节, 不够时容量翻倍, 所以逐字输入均摊 O(1)
+void gapReserve(struct gapLine *l, int n) {
+    if (l->gap_end - l->gap_start >= n) return;
+    int len = gapLength(l);
+    int cap = l->cap ? l->cap : 16;
+    while (cap - len < n) cap *= 2;
+    
+    char *buf = realloc(l->buf, cap);
+    if (buf == NULL) die("realloc");
+    int tail = l->cap - l->gap_end;
+    memmove(buf + cap - tail, buf + l->gap_end, tail);
+    l->buf = buf;
+    l->gap_end = cap - tail;
+    l->cap = cap;
+}
+
+void gapInsertAt(struct gapLine *l, int col, const char *s, int len) {
+    gapReserve(l, len);
+    gapMove(l, col);
+    memcpy(l->buf + l->gap_start, s, len);
+    l->gap_start += len;
+}
+
+// 复制 [col, col + n) 的内容, 最多涉及间隙前后两段
+int gapCopy(struct gapLine *l, int col, char *dst, int n) {
+    int len = gapLength(l);
+    if (col >= len) return 0;
+    if (n > len - col) n = len - col;
+    
+    int done = 0;
+    if (col < l->gap_start) {
+        done = l->gap_start - col < n ? l->gap_start - col : n;
+        memcpy(dst, l->buf + col, done);
+    }
+    if (done < n) {
+        memcpy(dst + done, l->buf + l->gap_end + col + done - l->gap_start, n - done);
+    }
+    return n;
+}
+
+// 在第 at 行之前插入 n 个空行
+void gapInsertLines(long at, long n) {
+    struct gapBuffer *g = &E.gap;
+    if (g->count + n > g->cap) {
+        while (g->count + n > g->cap) g->cap = g->cap ? g->cap * 2 : 256;
+        g->lines = realloc(g->lines, g->cap * sizeof(struct gapLine));
+        if (g->lines == NULL) die("realloc");
+    }
+    memmove(&g->lines[at + n], &g->lines[at], (g->count - at) * sizeof(struct gapLine));
+    memset(&g->lines[at], 0, n * sizeof(struct gapLine));
+    g->count += n;
+}
+
+// 把映射的文件内容逐行复制到间隙缓冲区, 之后不再需要映射
+void gapLoad() {
+    long rows = indexLines(LONG_MAX);
+    gapInsertLines(0, rows);
+    for (long row = 0; row < rows; row++) {
+        size_t start, end;
+        lineRange(row, &start, &end);
+        gapInsertAt(&E.gap.lines[row], 0, E.map + start, end - start);
+    }
+    if (E.map) munmap((void *)E.map, E.size);
+    E.map = NULL;
+    E.size = 0;
+}
+
+long gapRows(long want) {
+    (void)want;
+    return E.gap.count;
+}
+
+int gapComplete() {
+    return 1;
+}
+
+int gapLineLength(long row) {
+    return gapLength(&E.gap.lines[row]);
+}
+
+int gapRead(long row, int col, char *dst, int n) {
+    return gapCopy(&E.gap.lines[row], col, dst, n);
+}
+
+// 插入的文本中有换行符时, 把行尾移到新的行中
+void gapInsert(long row, int col, const char *s, size_t len) {
+    const char *nl;
+    while ((nl = memchr(s, '\n', len)) != NULL) {
+        struct gapLine *l = &E.gap.lines[row];
+        gapInsertAt(l, col, s, nl - s);
+        
+        // 间隙之后的部分成为下一行
+        gapInsertLines(row + 1, 1);
+        l = &E.gap.lines[row];
+        struct gapLine *next = &E.gap.lines[row + 1];
+        gapInsertAt(next, 0, l->buf + l->gap_end, l->cap - l->gap_end);
+        l->gap_end = l->cap;
+        
+        len -= nl - s + 1;
+        s = nl + 1;
+        row++;
+        col = 0;
+    }
+    gapInsertAt(&E.gap.lines[row], col, s, len);
+}
+
+void gapErase(long row, int col, size_t len) {
+    while (len > 0) {
+        struct gapLine *l = &E.gap.lines[row];
+        int rest = gapLength(l) - col;
+        if (rest > 0) {
+            int n = (size_t)rest < len ? rest : (int)len;
+            gapMove(l, col);
+            l->gap_end += n;
+            len -= n;
+            continue;
+        }
+        
+        // 删除行尾的换行符: 把下一行接到本行后面
+        if (row + 1 >= E.gap.count) return;
+        struct gapLine next = E.gap.lines[row + 1];
+        gapMove(&next, gapLength(&next));
+        gapInsertAt(l, col, next.buf, next.gap_start);
+        free(next.buf);
+        memmove(&E.gap.lines[row + 1], &E.gap.lines[row + 2], (E.gap.count - row - 2) * sizeof(struct gapLine));
+        E.gap.count--;
+        len--;
+    }
+}
+
+long long gapWrite(int fd) {
+    long long total = 0;
+    for (long row = 0; row < E.gap.count; row++) {
+        struct gapLine *l = &E.gap.lines[row];
+        if (writeAll(fd, l->buf, l->gap_start) == -1) return -1;
+        if (writeAll(fd, l->buf + l->gap_end, l->cap - l->gap_end) == -1) return -1;
+        if (row + 1 < E.gap.count && writeAll(fd, "\n", 1) == -1) return -1;
+        total += gapLength(l) + (row + 1 < E.gap.count);
+    }
+    return total;
+}
+
+const struct textBackend gapBackend = {
+    "gap", gapRows, gapComplete, gapLineLength, gapRead, gapInsert, gapErase, gapWrite
+};
+
+// 绳索
+
+// 叶子的最大字节数, 载入文件时按这个大小切分
+#define ROPE_LEAF 4096
+
+int ropeHeight(struct ropeNode *t) {
+    return t ? t->height : 0;
+}
+
+size_t ropeBytes(struct ropeNode *t) {
+    return t ? t->bytes : 0;
+}
+
+size_t ropeLf(struct ropeNode *t) {
+    return t ? t->lf : 0;
+}
+
+int ropeIsLeaf(struct ropeNode *t) {
+    return t->left == NULL;
+}
+
+size_t countNewlines(const char *p, size_t len) {
+    const char *end = p + len;
+    size_t n = 0;
+    while ((p = memchr(p, '\n', end - p)) != NULL) {
+        p++;
+        n++;
+    }
+    return n;
+}
+
+struct ropeNode *ropeLeaf(char *data, size_t len, int owned) {
+    struct ropeNode *t = calloc(1, sizeof(struct ropeNode));
+    if (t == NULL) die("calloc");
+    t->data = data;
+    t->owned = owned;
+    t->height = 1;
+    t->bytes = len;
+    t->lf = countNewlines(data, len);
+    return t;
+}
+
+// 复制一段文本作为新叶子
+struct ropeNode *ropeLeafCopy(const char *s, size_t len) {
+    char *data = malloc(ROPE_LEAF);
+    if (data == NULL) die("malloc");
+    memcpy(data, s, len);
+    return ropeLeaf(data, len, 1);
+}
+
+void ropeFree(struct ropeNode *t) {
+    if (t == NULL) return;
+    ropeFree(t->left);
+    ropeFree(t->right);
+    if (t->owned) free(t->data);
+    free(t);
+}
+
+void ropeUpdate(struct ropeNode *t) {
+    int hl = ropeHeight(t->left), hr = ropeHeight(t->right);
+    t->height = (hl > hr ? hl : hr) + 1;
+    t->bytes = ropeBytes(t->left) + ropeBytes(t->right);
+    t->lf = ropeLf(t->left) + ropeLf(t->right);
+}
+
+struct ropeNode *ropeConcat(struct ropeNode *l, struct ropeNode *r) {
+    struct ropeNode *t = calloc(1, sizeof(struct ropeNode));
+    if (t == NULL) die("calloc");
+    t->left = l;
+    t->right = r;
+    ropeUpdate(t);
+    return t;
+}
+
+struct ropeNode *ropeRotateRight(struct ropeNode *t) {
+    struct ropeNode *l = t->left;
+    t->left = l->right;
+    ropeUpdate(t);
+    l->right = t;
+    ropeUpdate(l);
+    return l;
+}
+
+struct ropeNode *ropeRotateLeft(struct ropeNode *t) {
+    struct ropeNode *r = t->right;
+    t->right = r->left;
+    ropeUpdate(t);
+    r->left = t;
+    ropeUpdate(r);
+    return r;
+}
+
+// 子树高度差超过 1 时旋转, 每次只处理编辑路径上的结点, 不会整体重建
+struct ropeNode *ropeBalance(struct ropeNode *t) {
+    ropeUpdate(t);
+    int diff = ropeHeight(t->left) - ropeHeight(t->right);
+    if (diff > 1) {
+        if (ropeHeight(t->left->left) < ropeHeight(t->left->right)) t->left = ropeRotateLeft(t->left);
+        return ropeRotateRight(t);
+    }
+    if (diff < -1) {
+        if (ropeHeight(t->right->right) < ropeHeight(t->right->left)) t->right = ropeRotateRight(t->right);
+        return ropeRotateLeft(t);
+    }
+    return t;
+}
+
+// 连接两棵绳索, 沿较高一棵的边缘下降到高度相近处再连接, O(高度差)。
+// 两片相邻的叶子能放进一片时合并, 避免反复编辑留下许多碎片
+struct ropeNode *ropeJoin(struct ropeNode *l, struct ropeNode *r) {
+    if (l == NULL) return r;
+    if (r == NULL) return l;
+    if (ropeHeight(l) > ropeHeight(r) + 1) {
+        l->right = ropeJoin(l->right, r);
+        return ropeBalance(l);
+    }
+    if (ropeHeight(r) > ropeHeight(l) + 1) {
+        r->left = ropeJoin(l, r->left);
+        return ropeBalance(r);
+    }
+    if (ropeIsLeaf(l) && ropeIsLeaf(r) && l->bytes + r->bytes <= ROPE_LEAF) {
+        struct ropeNode *t = ropeLeafCopy(l->data, l->bytes);
+        memcpy(t->data + l->bytes, r->data, r->bytes);
+        t->bytes += r->bytes;
+        t->lf += r->lf;
+        ropeFree(l);
+        ropeFree(r);
+        return t;
+    }
+    return ropeConcat(l, r);
+}
+
+// 按字节偏移把绳索分成两棵, O(log n)
+void ropeSplit(struct ropeNode *t, size_t off, struct ropeNode **l, struct ropeNode **r) {
+    if (t == NULL) {
+        *l = *r = NULL;
+    } else if (off == 0) {
+        *l = NULL;
+        *r = t;
+    } else if (off >= t->bytes) {
+        *l = t;
+        *r = NULL;
+    } else if (ropeIsLeaf(t)) {
+        *l = ropeLeafCopy(t->data, off);
+        *r = ropeLeafCopy(t->data + off, t->bytes - off);
+        ropeFree(t);
+    } else {
+        struct ropeNode *a, *b;
+        size_t lb = ropeBytes(t->left);
+        if (off < lb) {
+            ropeSplit(t->left, off, &a, &b);
+            *l = a;
+            *r = ropeJoin(b, t->right);
+        } else {
+            ropeSplit(t->right, off - lb, &a, &b);
+            *l = ropeJoin(t->left, a);
+            *r = b;
+        }
+        free(t);
+    }
+}
+
+// 由一串叶子自底向上建成平衡的绳索
+struct ropeNode *ropeBuild(struct ropeNode **leaves, long n) {
+    if (n == 0) return NULL;
+    if (n == 1) return leaves[0];
+    return ropeConcat(ropeBuild(leaves, n / 2), ropeBuild(leaves + n / 2, n - n / 2));
+}
+
+// 一段文本切成叶子后建成绳索
+struct ropeNode *ropeFromText(const char *s, size_t len, int copy) {
+    long n = (len + ROPE_LEAF - 1) / ROPE_LEAF;
+    struct ropeNode **leaves = malloc((n ? n : 1) * sizeof(struct ropeNode *));
+    if (leaves == NULL) die("malloc");
+    for (long i = 0; i < n; i++) {
+        size_t k = len - i * ROPE_LEAF < ROPE_LEAF ? len - i * ROPE_LEAF : ROPE_LEAF;
+        leaves[i] = copy ? ropeLeafCopy(s + i * ROPE_LEAF, k) : ropeLeaf((char *)s + i * ROPE_LEAF, k, 0);
+    }
+    struct ropeNode *t = ropeBuild(leaves, n);
+    free(leaves);
+    return t;
+}
+
+// 修改前把叶子的内容复制到自己的内存
+void ropeOwn(struct ropeNode *t) {
+    if (t->owned) return;
+    char *data = malloc(ROPE_LEAF);
+    if (data == NULL) die("malloc");
+    memcpy(data, t->data, t->bytes);
+    t->data = data;
+    t->owned = 1;
+}
+
+// 插入后仍放得下时直接改写所在叶子并更新路径上的计数, 返回 0 表示需要拆分
+int ropeInsertLeaf(struct ropeNode *t, size_t off, const char *s, size_t len, size_t lf) {
+    if (ropeIsLeaf(t)) {
+        if (t->bytes + len > ROPE_LEAF) return 0;
+        ropeOwn(t);
+        memmove(t->data + off + len, t->data + off, t->bytes - off);
+        memcpy(t->data + off, s, len);
+    } else {
+        size_t lb = ropeBytes(t->left);
+        int ok = off <= lb ? ropeInsertLeaf(t->left, off, s, len, lf)
+                           : ropeInsertLeaf(t->right, off - lb, s, len, lf);
+        if (!ok) return 0;
+    }
+    t->bytes += len;
+    t->lf += lf;
+    return 1;
+}
+
+// 删除后所在叶子不为空时直接改写, 返回 0 表示需要拆分
+int ropeEraseLeaf(struct ropeNode *t, size_t off, size_t len, size_t *lf) {
+    if (ropeIsLeaf(t)) {
+        if (off + len > t->bytes || len >= t->bytes) return 0;
+        ropeOwn(t);
+        *lf = countNewlines(t->data + off, len);
+        memmove(t->data + off, t->data + off + len, t->bytes - off - len);
+    } else {
+        size_t lb = ropeBytes(t->left);
+        int ok = off < lb ? ropeEraseLeaf(t->left, off, len, lf)
+                          : ropeEraseLeaf(t->right, off - lb, len, lf);
+        if (!ok) return 0;
+    }
+    t->bytes -= len;
+    t->lf -= *lf;
+    return 1;
+}
+
+// 第 k 个换行符之后的偏移, 即第 k 行的行首
+size_t ropeLineStart(size_t k) {
+    struct ropeNode *t = E.rope;
+    size_t off = 0;
+    if (k == 0 || t == NULL) return 0;
+    while (!ropeIsLeaf(t)) {
+        if (k <= ropeLf(t->left)) {
+            t = t->left;
+        } else {
+            k -= ropeLf(t->left);
+            off += ropeBytes(t->left);
+            t = t->right;
+        }
+    }
+    const char *p = t->data;
+    while (k-- > 0) {
+        p = (const char *)memchr(p, '\n', t->data + t->bytes - p) + 1;
+    }
+    return off + (p - t->data);
+}
+
+// 复制 [off, off + n) 的内容
+size_t ropeCopy(struct ropeNode *t, size_t off, size_t n, char *dst) {
+    if (t == NULL || n == 0 || off >= t->bytes) return 0;
+    if (ropeIsLeaf(t)) {
+        if (n > t->bytes - off) n = t->bytes - off;
+        memcpy(dst, t->data + off, n);
+        return n;
+    }
+    size_t lb = ropeBytes(t->left);
+    size_t done = off < lb ? ropeCopy(t->left, off, n, dst) : 0;
+    if (done < n) {
+        size_t from = off + done - lb;
+        done += ropeCopy(t->right, from, n - done, dst + done);
+    }
+    return done;
+}
+
+// 把映射的文件切成叶子, 叶子先直接指向映射, 修改时才复制
+void ropeLoad() {
+    E.rope = ropeFromText(E.map, E.size, 0);
+}
+
+long ropeRows(long want) {
+    (void)want;
+    return ropeLf(E.rope) + 1;
+}
+
+int ropeComplete() {
+    return 1;
+}
+
+void ropeRowSpan(long row, size_t *start, size_t *end) {
+    *start = ropeLineStart(row);
+    *end = row < (long)ropeLf(E.rope) ? ropeLineStart(row + 1) - 1 : ropeBytes(E.rope);
+}
+
+int ropeLineLength(long row) {
+    size_t start, end;
+    ropeRowSpan(row, &start, &end);
+    return end - start;
+}
+
+int ropeRead(long row, int col, char *dst, int n) {
+    size_t start, end;
+    ropeRowSpan(row, &start, &end);
+    if (end - start <= (size_t)col) return 0;
+    if (end - start - col < (size_t)n) n = end - start - col;
+    return ropeCopy(E.rope, start + col, n, dst);
+}
+
+void ropeInsert(long row, int col, const char *s, size_t len) {
+    size_t off = ropeLineStart(row) + col;
+    if (E.rope && ropeInsertLeaf(E.rope, off, s, len, countNewlines(s, len))) return;
+    
+    struct ropeNode *l, *r;
+    ropeSplit(E.rope, off, &l, &r);
+    E.rope = ropeJoin(ropeJoin(l, ropeFromText(s, len, 1)), r);
+}
+
+void ropeErase(long row, int col, size_t len) {
+    size_t off = ropeLineStart(row) + col;
+    if (off >= ropeBytes(E.rope)) return;
+    size_t lf = 0;
+    if (ropeEraseLeaf(E.rope, off, len, &lf)) return;
+    
+    struct ropeNode *l, *m, *r;
+    ropeSplit(E.rope, off, &l, &r);
+    ropeSplit(r, len, &m, &r);
+    ropeFree(m);
+    E.rope = ropeJoin(l, r);
+}
+
+int ropeWriteNode(int fd, struct ropeNode *t) {
+    if (t == NULL) return 0;
+    if (ropeIsLeaf(t)) return writeAll(fd, t->data, t->bytes);
+    if (ropeWriteNode(fd, t->left) == -1) return -1;
+    return ropeWriteNode(fd, t->right);
 }
 
+long long ropeWrite(int fd) {
+    if (ropeWriteNode(fd, E.rope) == -1) return -1;
+    return ropeBytes(E.rope);
+}
+
+const struct textBackend ropeBackend = {
+    "rope", ropeRows, ropeComplete, ropeLineLength, ropeRead, ropeInsert, ropeErase, ropeWrite
+};
+
+
+// 输入缓冲区: 一次读入终端上所有已到达的字节
+#define INPUT_BUF 4096
+
+unsigned char inbuf[INPUT_BUF];
+int inlen = 0;
+int inpos = 0;
+
+// 等待输入最多 timeout 毫秒 (-1 表示一直等), 读入所有已到达的字节, 返回读到的字节数
+int inputFill(int timeout) {
+    struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+    int n = poll(&pfd, 1, timeout);
+    if (n == -1 && errno != EINTR) die("poll");
+    if (n <= 0) return 0;
+    
+    if (inpos > 0) {
+        memmove(inbuf, inbuf + inpos, inlen - inpos);
+        inlen -= inpos;
+        inpos = 0;
+    }
+    ssize_t r = read(STDIN_FILENO, inbuf + inlen, INPUT_BUF - inlen);
+    if (r == -1) {
+        if (errno == EAGAIN || errno == EINTR) return 0;
+        die("read");
+    }
+    // 终端已关闭
+    if (r == 0) exit(0);
+    inlen += r;
+    return r;
+}
+
+// 缓冲区中是否还有未处理的字节
+int inputPending() {
+    return inpos < inlen;
+}
+
+// 取一个字节, 缓冲区为空时最多等 timeout 毫秒, 超时返回 -1
+int inputByte(int timeout) {
+    if (inpos == inlen && inputFill(timeout) <= 0) return -1;
+    return inbuf[inpos++];
+}
+
+int getCursorPosition(int *rows, int *cols);
+
 // 获取终端大小
 int getWindowSize(int *rows, int *cols) {
     struct winsize ws;
@@ -130,7 +1301,9 @@ int getCursorPosition(int *rows, int *cols) {
     
     // 读取响应
     while (i < sizeof(buf) - 1) {
-        if (read(STDIN_FILENO, &buf[i], 1) != 1) break;
+        int c = inputByte(1000);
+        if (c == -1) break;
+        buf[i] = c;
         if (buf[i] == 'R') break;
         i++;
     }
@@ -149,57 +1322,11 @@ void clearScreen() {
     write(STDOUT_FILENO, "\x1b[H", 3);
 }
 
-// 读取按键
-int readKey() {
-    int nread;
-    char c;
-    while ((nread = read(STDIN_FILENO, &c, 1)) != 1) {
-        if (nread == -1 && errno != EAGAIN) die("read");
-    }
-    
-    // 处理转义序列
-    if (c == '\x1b') {
-        char seq[3];
-        
-        if (read(STDIN_FILENO, &seq[0], 1) != 1) return '\x1b';
-        if (read(STDIN_FILENO, &seq[1], 1) != 1) return '\x1b';
-        
-        if (seq[0] == '[') {
-            if (seq[1] >= '0' && seq[1] <= '9') {
-                if (read(STDIN_FILENO, &seq[2], 1) != 1) return '\x1b';
-                if (seq[2] == '~') {
-                    switch (seq[1]) {
-                        case '1': return KEY_HOME;
-                        case '3': return KEY_DEL;
-                        case '4': return KEY_END;
-                        case '5': return KEY_PAGE_UP;
-                        case '6': return KEY_PAGE_DOWN;
-                        case '7': return KEY_HOME;
-                        case '8': return KEY_END;
-                    }
-                }
-            } else {
-                switch (seq[1]) {
-                    case 'A': return KEY_UP;
-                    case 'B': return KEY_DOWN;
-                    case 'C': return KEY_RIGHT;
-                    case 'D': return KEY_LEFT;
-                    case 'H': return KEY_HOME;
-                    case 'F': return KEY_END;
-                }
-            }
-        } else if (seq[0] == 'O') {
-            switch (seq[1]) {
-                case 'H': return KEY_HOME;
-                case 'F': return KEY_END;
-            }
-        }
-        
-        return '\x1b';
-    } else {
-        return c;
-    }
-}
+// 按键解码器, 未结束的转义序列跨越多次读取保留在这里
+struct keyDecoder decoder;
+
+// 单独的 ESC 等待后续字节的时间 (毫秒), --esc-ms 可调
+int escTimeout = KD_ESC_TIMEOUT_MS;
 
 // 移动光标
 void moveCursor(int key) {
@@ -208,152 +1335,606 @@ void moveCursor(int key) {
             if (E.cursor_y > 0) E.cursor_y--;
             break;
         case KEY_DOWN:
-            if (E.cursor_y < E.screenrows - 1) E.cursor_y++;
+            if (E.buf->rows(E.cursor_y + 1) > E.cursor_y + 1) E.cursor_y++;
             break;
         case KEY_LEFT:
-            if (E.cursor_x > 0) E.cursor_x--;
+            if (E.cursor_x > 0) {
+                E.cursor_x--;
+            } else if (E.cursor_y > 0) {
+                E.cursor_y--;
+                E.cursor_x = E.buf->lineLength(E.cursor_y);
+            }
             break;
         case KEY_RIGHT:
-            if (E.cursor_x < E.screencols - 1) E.cursor_x++;
+            if (E.cursor_x < E.buf->lineLength(E.cursor_y)) {
+                E.cursor_x++;
+            } else if (E.buf->rows(E.cursor_y + 1) > E.cursor_y + 1) {
+                E.cursor_y++;
+                E.cursor_x = 0;
+            }
             break;
         case KEY_HOME:
             E.cursor_x = 0;
             break;
         case KEY_END:
-            E.cursor_x = E.screencols - 1;
+            E.cursor_x = E.buf->lineLength(E.cursor_y);
             break;
         case KEY_PAGE_UP:
-            E.cursor_y = 0;
+            E.cursor_y -= E.screenrows;
+            if (E.cursor_y < 0) E.cursor_y = 0;
             break;
-        case KEY_PAGE_DOWN:
-            E.cursor_y = E.screenrows - 1;
+        case CTRL_KEY('g'):
+            // 跳到最后一行, 片段表需要扫描整个文件
+            if (E.buf == &pieceBackend) {
+                indexAll(scanThreads > 0 ? scanThreads : (int)sysconf(_SC_NPROCESSORS_ONLN));
+            }
+            E.cursor_y = E.buf->rows(0) - 1;
+            break;
+        case KEY_PAGE_DOWN: {
+            long rows = E.buf->rows(E.cursor_y + E.screenrows);
+            E.cursor_y += E.screenrows;
+            if (E.cursor_y > rows - 1) E.cursor_y = rows - 1;
             break;
+        }
     }
+    
+    // 换行后光标不超过行尾
+    int len = E.buf->lineLength(E.cursor_y);
+    if (E.cursor_x > len) E.cursor_x = len;
+}
+
+// 在状态栏显示一条消息, 五秒后恢复
+void setStatusMessage(const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(E.statusmsg, sizeof(E.statusmsg), fmt, ap);
+    va_end(ap);
+    E.statusmsg_time = time(NULL);
+}
+
+// 在光标处插入一个字符
+void insertChar(int c) {
+    char ch = c;
+    E.buf->insert(E.cursor_y, E.cursor_x, &ch, 1);
+    E.cursor_x++;
+    E.dirty = 1;
+}
+
+// 在光标处断行
+void insertNewline() {
+    E.buf->insert(E.cursor_y, E.cursor_x, "\n", 1);
+    E.cursor_y++;
+    E.cursor_x = 0;
+    E.dirty = 1;
+}
+
+// 删除光标前 (退格) 或光标处的字符, 跨过行尾时合并两行
+void deleteChar(int backspace) {
+    if (backspace) {
+        if (E.cursor_x == 0 && E.cursor_y == 0) return;
+        moveCursor(KEY_LEFT);
+    } else if (E.cursor_x == E.buf->lineLength(E.cursor_y) && E.buf->rows(E.cursor_y + 1) <= E.cursor_y + 1) {
+        return;
+    }
+    E.buf->erase(E.cursor_y, E.cursor_x, 1);
+    E.dirty = 1;
+}
+
+// 保存: 先写临时文件再改名, 改名后原文件的映射仍然有效
+void saveFile() {
+    if (E.filename == NULL) {
+        setStatusMessage("No file name");
+        return;
+    }
+    char tmp[strlen(E.filename) + 5];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", E.filename);
+    
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    long long bytes = fd == -1 ? -1 : E.buf->write(fd);
+    if (bytes == -1 || fsync(fd) == -1) {
+        setStatusMessage("Can't save: %s", strerror(errno));
+        if (fd != -1) {
+            close(fd);
+            unlink(tmp);
+        }
+        return;
+    }
+    close(fd);
+    if (rename(tmp, E.filename) == -1) {
+        setStatusMessage("Can't save: %s", strerror(errno));
+        unlink(tmp);
+        return;
+    }
+    E.dirty = 0;
+    setStatusMessage("%lld bytes written", bytes);
+}
+
+// 行号栏宽度, 按屏幕上最大的行号计算
+int gutterWidth() {
+    return snprintf(NULL, 0, "%ld", E.rowoff + E.screenrows) + 1;
+}
+
+// 让光标保持在可见范围内
+void scroll() {
+    int textcols = E.screencols - gutterWidth();
+    if (textcols < 1) textcols = 1;
+    
+    if (E.cursor_y < E.rowoff) E.rowoff = E.cursor_y;
+    if (E.cursor_y >= E.rowoff + E.screenrows) E.rowoff = E.cursor_y - E.screenrows + 1;
+    if (E.cursor_x < E.coloff) E.coloff = E.cursor_x;
+    if (E.cursor_x >= E.coloff + textcols) E.coloff = E.cursor_x - textcols + 1;
 }
 
 // 绘制欢迎信息
-void drawWelcome(struct appendBuffer *ab) {
+int drawWelcome(char *dst, int width) {
     char welcome[80];
     int welcomelen = snprintf(welcome, sizeof(welcome), 
         "Tiny Editor -- version 0.0.1");
-    if (welcomelen > E.screencols) welcomelen = E.screencols;
+    if (welcomelen > width) welcomelen = width;
     
     // 居中显示欢迎信息
-    int padding = (E.screencols - welcomelen) / 2;
+    int padding = (width - welcomelen) / 2;
+    int len = 0;
     if (padding) {
-        abAppend(ab, "~", 1);
+        dst[len++] = '~';
         padding--;
     }
-    while (padding--) abAppend(ab, " ", 1);
+    while (padding--) dst[len++] = ' ';
     
-    abAppend(ab, welcome, welcomelen);
+    memcpy(dst + len, welcome, welcomelen);
+    return len + welcomelen;
 }
 
-// 刷新屏幕
-void refreshScreen() {
-    struct appendBuffer ab = AB_INIT;
+// 绘制文件的一行, 控制字符显示为 '?', 制表符显示为空格, 行尾的回车不显示
+int drawLine(char *dst, long row, int width) {
+    if (width <= 0) return 0;
+    int len = E.buf->read(row, E.coloff, dst, width);
+    if (len > 0 && dst[len - 1] == '\r' && E.coloff + len == E.buf->lineLength(row)) len--;
     
-    // 隐藏光标
-    abAppend(&ab, "\x1b[?25l", 6);
-    
-    // 移动光标到左上角
-    abAppend(&ab, "\x1b[H", 3);
+    for (int i = 0; i < len; i++) {
+        unsigned char c = dst[i];
+        if (c == '\t') dst[i] = ' ';
+        else if (c < 32 || c == 127) dst[i] = '?';
+    }
+    return len;
+}
+
+// 绘制状态栏: 文件名、行数和光标位置, 占满一整行
+void drawStatus(char *dst, int width) {
+    char left[80], right[80];
+    int leftlen;
+    if (E.statusmsg[0] && time(NULL) - E.statusmsg_time < 5) {
+        leftlen = snprintf(left, sizeof(left), "%s", E.statusmsg);
+    } else {
+        leftlen = snprintf(left, sizeof(left), "%.40s - %ld%s lines%s",
+            E.filename ? E.filename : "[No Name]", E.buf->rows(0), E.buf->complete() ? "" : "+",
+            E.dirty ? " (modified)" : "");
+    }
+    int rightlen;
+    if (frameStats) {
+        rightlen = snprintf(right, sizeof(right), "[Cursor: %ld,%d] [Frame: %d B, %d allocs]",
+            E.cursor_y + 1, E.cursor_x + 1, lastFrameBytes, lastFrameAllocs);
+    } else {
+        rightlen = snprintf(right, sizeof(right), "[Cursor: %ld,%d] [Size: %dx%d]",
+            E.cursor_y + 1, E.cursor_x + 1, E.screencols, E.screenrows + 1);
+    }
+    if (leftlen > width) leftlen = width;
     
-    // 绘制屏幕内容
+    memcpy(dst, left, leftlen);
+    if (leftlen + rightlen <= width) {
+        memcpy(dst + width - rightlen, right, rightlen);
+    }
+}
+
+// 屏幕网格: 每个字节是一个格子, 每行末尾未用的部分为空格
+struct screenGrid {
+    char *cells;
+    unsigned char *inverse;   // 每行是否反色显示
+    int rows;
+    int cols;
+};
+
+// shadow 是终端上现在显示的内容, next 是这一帧要显示的内容
+struct screenGrid shadow, next;
+int shadowValid = 0;
+long shadowRowoff = 0;    // shadow 显示时的滚动位置
+int shadowColoff = 0;
+
+void gridInit(struct screenGrid *g, int rows, int cols) {
+    g->cells = malloc((size_t)rows * cols);
+    g->inverse = calloc(rows, 1);
+    if (g->cells == NULL || g->inverse == NULL) die("malloc");
+    memset(g->cells, ' ', (size_t)rows * cols);
+    g->rows = rows;
+    g->cols = cols;
+}
+
+char *gridRow(struct screenGrid *g, int y) {
+    return g->cells + (size_t)y * g->cols;
+}
+
+// 行中是否有非 ASCII 字节。这种行的字节和终端列不一一对应, 只能整行重画
+int rowHasWide(const char *row, int cols) {
+    for (int x = 0; x < cols; x++) {
+        if ((unsigned char)row[x] >= 128) return 1;
+    }
+    return 0;
+}
+
+// 把这一帧画进 next 网格
+void renderGrid(int gutter) {
     for (int y = 0; y < E.screenrows; y++) {
-        // 绘制行号
-        char line[32];
-        int linelen = snprintf(line, sizeof(line), "%d ", y + 1);
-        if (linelen > 0) {
-            abAppend(&ab, line, linelen);
-        }
+        char *dst = gridRow(&next, y);
+        int width = next.cols;
+        int len = 0;
+        long row = E.rowoff + y;
         
-        // 绘制内容
-        if (y == 0) {
-            drawWelcome(&ab);
+        if (E.buf->rows(row) > row) {
+            // 绘制行号
+            char line[32];
+            int linelen = snprintf(line, sizeof(line), "%*ld ", gutter - 1, row + 1);
+            if (linelen > width) linelen = width;
+            memcpy(dst, line, linelen);
+            len = linelen;
+            
+            // 绘制内容
+            if (E.filename == NULL && row == 0) {
+                len += drawWelcome(dst + len, width - len);
+            } else {
+                len += drawLine(dst + len, row, width - len);
+            }
         } else {
-            abAppend(&ab, "~", 1);
+            dst[len++] = '~';
         }
+        memset(dst + len, ' ', width - len);
+        next.inverse[y] = 0;
+    }
+    
+    // 最后一行是状态栏
+    char *status = gridRow(&next, E.screenrows);
+    memset(status, ' ', next.cols);
+    drawStatus(status, next.cols);
+    next.inverse[E.screenrows] = 1;
+}
+
+void moveTo(struct appendBuffer *ab, int y, int x) {
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), "\x1b[%d;%dH", y + 1, x + 1);
+    abAppend(ab, buf, len);
+}
+
+// 输出一行中 [from, to) 的内容; 新内容之后全是空格时用清除行尾代替
+void emitSpan(struct appendBuffer *ab, int y, int from, int to) {
+    const char *row = gridRow(&next, y);
+    int blank = next.cols;
+    while (blank > 0 && row[blank - 1] == ' ') blank--;
+    
+    moveTo(ab, y, from);
+    if (next.inverse[y]) abAppend(ab, "\x1b[7m", 4);
+    // 内容写到最后一列时光标停在行尾等待换行, 这时清除行尾会删掉刚写的字符。
+    // 含非 ASCII 字节的行占的列数少于字节数, 写不到最后一列, 清除行尾总是安全的
+    int erase = blank < next.cols || rowHasWide(row, next.cols);
+    if (to >= blank && erase && !next.inverse[y]) {
+        if (blank > from) abAppend(ab, row + from, blank - from);
+        abAppend(ab, "\x1b[K", 3);
+    } else {
+        abAppend(ab, row + from, to - from);
+    }
+    if (next.inverse[y]) abAppend(ab, "\x1b[m", 3);
+}
+
+// 视图上下滚动不到一屏时, 在文本区设置滚动区域 (DECSTBM), 用 IND / RI 让终端自己移动已有的行,
+// 并同样移动 shadow 中的行, 之后的比较就只剩新露出的行和状态栏
+void emitScroll(struct appendBuffer *ab) {
+    long delta = E.rowoff - shadowRowoff;
+    int rows = E.screenrows;
+    int cols = shadow.cols;
+    int scrolled = shadowValid && delta != 0 && E.coloff == shadowColoff
+        && delta > -rows && delta < rows;
+    shadowRowoff = E.rowoff;
+    shadowColoff = E.coloff;
+    if (!scrolled) return;
+    
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), "\x1b[1;%dr", rows);
+    abAppend(ab, buf, len);
+    int n = delta > 0 ? delta : -delta;
+    if (delta > 0) {
+        // 在区域底部换行, 内容上移
+        moveTo(ab, rows - 1, 0);
+        for (int i = 0; i < n; i++) abAppend(ab, "\x1b" "D", 2);
+        memmove(shadow.cells, shadow.cells + (size_t)n * cols, (size_t)(rows - n) * cols);
+        memset(shadow.cells + (size_t)(rows - n) * cols, ' ', (size_t)n * cols);
+    } else {
+        // 在区域顶部反向换行, 内容下移
+        moveTo(ab, 0, 0);
+        for (int i = 0; i < n; i++) abAppend(ab, "\x1b" "M", 2);
+        memmove(shadow.cells + (size_t)n * cols, shadow.cells, (size_t)(rows - n) * cols);
+        memset(shadow.cells, ' ', (size_t)n * cols);
+    }
+    abAppend(ab, "\x1b[r", 3);
+}
+
+// 对比两个网格, 只输出变化的行中从第一个到最后一个不同格子之间的部分
+void emitDiff(struct appendBuffer *ab) {
+    for (int y = 0; y < next.rows; y++) {
+        const char *old = gridRow(&shadow, y);
+        const char *new = gridRow(&next, y);
+        int cols = next.cols;
         
-        // 清除行尾
-        abAppend(&ab, "\x1b[K", 3);
-        
-        // 如果不是最后一行，添加换行符
-        if (y < E.screenrows - 1) {
-            abAppend(&ab, "\r\n", 2);
+        if (!shadowValid || shadow.inverse[y] != next.inverse[y]
+            || rowHasWide(old, cols) || rowHasWide(new, cols)) {
+            if (shadowValid && shadow.inverse[y] == next.inverse[y] && memcmp(old, new, cols) == 0) continue;
+            emitSpan(ab, y, 0, cols);
+            continue;
         }
+        
+        int from = 0, to = cols;
+        while (from < cols && old[from] == new[from]) from++;
+        if (from == cols) continue;
+        while (to > from && old[to - 1] == new[to - 1]) to--;
+        emitSpan(ab, y, from, to);
     }
     
-    // 显示光标位置
-    char status[80];
-    int statuslen = snprintf(status, sizeof(status), 
-        "[Cursor: %d,%d] [Size: %d×%d]",
-        E.cursor_y + 1, E.cursor_x + 1, E.screencols, E.screenrows);
-    if (statuslen > E.screencols) statuslen = E.screencols;
+    // 现在终端上显示的就是 next
+    struct screenGrid tmp = shadow;
+    shadow = next;
+    next = tmp;
+    shadowValid = 1;
+}
+
+// 每帧的输出缓冲区, 只在第一帧和屏幕变大时扩容
+struct appendBuffer frame = AB_INIT;
+
+// 刷新屏幕: 先画进网格, 再只把与终端上不同的部分发出去
+void refreshScreen() {
+    struct appendBuffer *ab = &frame;
+    abReset(ab);
+    abAllocs = 0;
+    scroll();
+    int gutter = gutterWidth();
+    
+    renderGrid(gutter);
     
-    // 移动光标到状态行
-    abAppend(&ab, "\x1b[999C", 6);  // 移动到行尾
-    abAppend(&ab, "\x1b[1A", 4);    // 上移一行
+    // 有内容变化时先隐藏光标, 避免光标在重画过程中闪动
+    abAppend(ab, "\x1b[?25l", 6);
+    int start = ab->len;
+    emitScroll(ab);
+    emitDiff(ab);
+    int changed = ab->len > start;
+    if (!changed) abReset(ab);
     
-    // 显示状态信息
-    abAppend(&ab, "\x1b[7m", 4);    
-    abAppend(&ab, status, statuslen);
-    abAppend(&ab, "\x1b[m", 3);     
     // 移动光标到实际位置
-    char buf[32];
-    snprintf(buf, sizeof(buf), "\x1b[%d;%dH", E.cursor_y + 1, E.cursor_x + 1);
-    abAppend(&ab, buf, strlen(buf));
+    moveTo(ab, E.cursor_y - E.rowoff, E.cursor_x - E.coloff + gutter);
     
     // 显示光标
-    abAppend(&ab, "\x1b[?25h", 6);
+    if (changed) abAppend(ab, "\x1b[?25h", 6);
     
     // 写入屏幕
-    write(STDOUT_FILENO, ab.b, ab.len);
-    abFree(&ab);
+    write(STDOUT_FILENO, ab->b, ab->len);
+    lastFrameBytes = ab->len;
+    lastFrameAllocs = abAllocs;
 }
 
 // 初始化编辑器
 void initEditor() {
     E.cursor_x = 0;
     E.cursor_y = 0;
+    E.rowoff = 0;
+    E.coloff = 0;
+    E.filename = NULL;
+    E.map = NULL;
+    E.size = 0;
+    
+    // 空文件也有一个空行
+    indexPush(&E.idx, 0);
     
     if (getWindowSize(&E.screenrows, &E.screencols)) die("getWindowSize");
+    gridInit(&shadow, E.screenrows, E.screencols);
+    gridInit(&next, E.screenrows, E.screencols);
+    E.screenrows -= 1;
+}
+
+// 处理一个按键, 返回 1 表示退出
+int processKey(int c) {
+    static int quitConfirm = 0;
+    
+    // 退出条件, 有未保存的修改时需要再按一次
+    if (c == CTRL_KEY('q') || c == KEY_ESC) {
+        if (E.dirty && !quitConfirm) {
+            setStatusMessage("Unsaved changes: press Ctrl-Q again to quit");
+            quitConfirm = 1;
+            return 0;
+        }
+        return 1;
+    }
+    quitConfirm = 0;
+    
+    // 处理编辑和光标移动
+    switch (c) {
+        case '\r':
+            insertNewline();
+            break;
+        case 127:
+        case CTRL_KEY('h'):
+            deleteChar(1);
+            break;
+        case KEY_DEL:
+            deleteChar(0);
+            break;
+        case CTRL_KEY('s'):
+            saveFile();
+            break;
+        case KEY_UP:
+        case KEY_DOWN:
+        case KEY_LEFT:
+        case KEY_RIGHT:
+        case KEY_HOME:
+        case KEY_END:
+        case KEY_PAGE_UP:
+        case KEY_PAGE_DOWN:
+        case CTRL_KEY('g'):
+            moveCursor(c);
+            break;
+        default:
+            if (c == '\t' || (c >= 32 && c < 256 && c != 127)) insertChar(c);
+            break;
+    }
+    return 0;
+}
+
+// 解码缓冲区中所有已到达的字节并逐个处理, 返回 1 表示退出。
+// 停在半个转义序列上时直接返回, 等下一次读取或超时再继续
+int processInput() {
+    int keys[KD_MAX_OUT];
+    while (inputPending()) {
+        int n = kdFeed(&decoder, inbuf[inpos++], keys);
+        for (int i = 0; i < n; i++) {
+            if (processKey(keys[i])) return 1;
+        }
+    }
+    return 0;
+}
+
+// 等待超时: 单独的 ESC 交出为 ESC 键, 不完整的序列丢弃, 返回 1 表示退出
+int flushInput() {
+    int keys[KD_MAX_OUT];
+    int n = kdFlush(&decoder, keys);
+    for (int i = 0; i < n; i++) {
+        if (processKey(keys[i])) return 1;
+    }
+    return 0;
+}
+
+// 选择文本后端, 间隙缓冲区在这里载入整个文件
+void selectBackend() {
+    const char *name = backendName;
+    if (name == NULL) name = E.size <= GAP_MAX_FILE ? "gap" : "piece";
+    if (strcmp(name, "gap") == 0) {
+        E.buf = &gapBackend;
+        gapLoad();
+    } else if (strcmp(name, "rope") == 0) {
+        E.buf = &ropeBackend;
+        ropeLoad();
+    } else {
+        E.buf = &pieceBackend;
+    }
+}
+
+double nowSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
 }
 
-int main() {
+// 清空行索引
+void indexReset() {
+    free(E.idx.start);
+    E.idx = (struct lineIndex){NULL, 0, 0, 0};
+    indexPush(&E.idx, 0);
+}
+
+// 对整个文件建立索引, 比较各扫描函数单线程和多线程的吞吐量
+void scanBench(const char *filename, int threads) {
+    openFile(filename);
+    if (threads <= 0) threads = sysconf(_SC_NPROCESSORS_ONLN);
+    
+    // 先把文件读进页缓存, 之后只测扫描本身
+    indexReset();
+    indexAll(threads);
+    long expect = E.idx.count;
+    printf("%s: %.2f GB, %ld 行\n", filename, E.size / 1e9, expect);
+    
+    for (int v = 0; v < SCAN_VARIANTS; v++) {
+        if (!scanVariants[v].supported) continue;
+        scanNewlines = scanVariants[v].fn;
+        int counts[2] = {1, threads};
+        for (int k = 0; k < 2; k++) {
+            if (k == 1 && threads == 1) break;
+            indexReset();
+            double t0 = nowSeconds();
+            indexAll(counts[k]);
+            double t = nowSeconds() - t0;
+            printf("%-8s %2d 线程  %8.3f s  %6.2f GB/s%s\n", scanVariants[v].name, counts[k],
+                t, E.size / t / 1e9, E.idx.count == expect ? "" : "  行数不一致");
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const char *filename = NULL;
+    const char *bench = NULL;
+    initScanner();
+    
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            scanThreads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--scan-bench") == 0 && i + 1 < argc) {
+            bench = argv[++i];
+        } else if (strcmp(argv[i], "--esc-ms") == 0 && i + 1 < argc) {
+            escTimeout = atoi(argv[++i]);
+            if (escTimeout < 0) escTimeout = 0;
+        } else if (strcmp(argv[i], "--frame-stats") == 0) {
+            frameStats = 1;
+        } else if (strcmp(argv[i], "--backend") == 0 && i + 1 < argc) {
+            backendName = argv[++i];
+            if (strcmp(backendName, "gap") != 0 && strcmp(backendName, "piece") != 0
+                && strcmp(backendName, "rope") != 0) {
+                fprintf(stderr, "未知的文本后端: %s (可选 gap, piece, rope)\n", backendName);
+                return 1;
+            }
+        } else {
+            filename = argv[i];
+        }
+    }
+    
+    if (bench) {
+        scanBench(bench, scanThreads);
+        return 0;
+    }
+    
     // 启用原始模式
     enableRawMode();
     
     // 初始化编辑器
     initEditor();
+    if (filename) {
+        openFile(filename);
+    }
+    selectBackend();
     
+    setStatusMessage("Ctrl-S = save | Ctrl-Q = quit | Ctrl-G = last line");
+    
+    kdInit(&decoder);
     while (1) {
         refreshScreen();
         
-        int c = readKey();
+        // 阻塞到有输入为止; 只有状态栏消息要到期, 或者停在半个转义序列上时才定时醒来
+        int timeout = -1;
+        if (E.statusmsg[0]) {
+            long left = E.statusmsg_time + 5 - time(NULL);
+            timeout = left > 0 ? left * 1000 : 0;
+        }
+        int pending = kdPending(&decoder);
+        if (pending) timeout = kdTimeout(&decoder, escTimeout);
         
-        // 退出条件
-        if (c == 'q' || c == KEY_ESC) {
+        // 处理这一批读到的所有按键, 之后只刷新一次
+        int quit = 0;
+        if (inputPending() || inputFill(timeout) > 0) {
+            quit = processInput();
+        } else if (pending) {
+            quit = flushInput();
+        } else {
+            if (time(NULL) - E.statusmsg_time >= 5) E.statusmsg[0] = '\0';
+            continue;
+        }
+        if (quit) {
             clearScreen();
+            abFree(&frame);
             break;
         }
-        
-        // 处理光标移动
-        switch (c) {
-            case KEY_UP:
-            case KEY_DOWN:
-            case KEY_LEFT:
-            case KEY_RIGHT:
-            case KEY_HOME:
-            case KEY_END:
-            case KEY_PAGE_UP:
-            case KEY_PAGE_DOWN:
-                moveCursor(c);
-                break;
-        }
     }
 
     printf("终端原始模式已禁用，恢复标准设置。\r\n");
     return 0;
 }
-
@@ -1,11 +1,14 @@
 #include <ctype.h>
 #include <errno.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <termios.h>
 #include <unistd.h>
 
+#include "keydecode.h"
+
 // 保存原始终端设置
 static struct termios orig_termios;
 
@@ -55,8 +58,8 @@ void enableRawMode() {
                    | ISIG);  // 禁用信号处理
     
     // 控制字符设置 (c_cc)
-    raw.c_cc[VMIN] = 0;      // 最小读取字符数
-    raw.c_cc[VTIME] = 1;     // 100ms超时 (VTIME以十分之一秒为单位)
+    raw.c_cc[VMIN] = 0;      // 读取立即返回已到达的字节
+    raw.c_cc[VTIME] = 0;     // 等待输入由 poll 完成
     
     // 应用修改后的终端设置
     if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) == -1) {
@@ -75,6 +78,17 @@ void printKeyInfo(unsigned char c) {
     }
 }
 
+// 打印解码后的按键, 特殊按键显示名字, 返回 1 表示退出
+int printKey(int key) {
+    const char *name = kdKeyName(key);
+    if (name) {
+        printf("%s\r\n", name);
+    } else {
+        printKeyInfo(key);
+    }
+    return key == 'q';
+}
+
 int main() {
     // 启用原始模式
     enableRawMode();
@@ -83,21 +97,35 @@ int main() {
     printf("按键信息将显示为: ASCII值 (字符表示)\r\n");
     printf("------------------------------------\r\n");
     
-    while (1) {
-        unsigned char c = '\0';
+    struct keyDecoder decoder;
+    kdInit(&decoder);
+    int keys[KD_MAX_OUT];
+    int quit = 0;
+    
+    while (!quit) {
+        // 停在半个转义序列上时定时醒来, 否则一直等到有输入
+        struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+        int pending = kdPending(&decoder);
+        int ready = poll(&pfd, 1, kdTimeout(&decoder, KD_ESC_TIMEOUT_MS));
+        if (ready == -1 && errno != EINTR) die("poll");
         
-        // 读取用户输入
-        if (read(STDIN_FILENO, &c, 1) == -1 && errno != EAGAIN) {
-            die("read");
+        // 超时: 单独的 ESC 当作 ESC 键, 不完整的序列丢弃
+        if (ready == 0 && pending) {
+            int n = kdFlush(&decoder, keys);
+            for (int i = 0; i < n && !quit; i++) quit = printKey(keys[i]);
+            continue;
         }
+        if (ready <= 0) continue;
         
-        // 显示按键信息
-        if (c != '\0') {
-            printKeyInfo(c);
+        // 读取所有已到达的字节, 逐个送入解码器
+        unsigned char buf[256];
+        ssize_t r = read(STDIN_FILENO, buf, sizeof(buf));
+        if (r == -1 && errno != EAGAIN && errno != EINTR) die("read");
+        if (r == 0) break;
+        for (ssize_t j = 0; j < r && !quit; j++) {
+            int n = kdFeed(&decoder, buf[j], keys);
+            for (int i = 0; i < n && !quit; i++) quit = printKey(keys[i]);
         }
-        
-        // 检测退出键 'q'
-        if (c == 'q') break;
     }
      
     // 注意：disableRawMode() 会在程序退出时通过 atexit 自动调用